@@ -0,0 +1,288 @@
+#pragma once
+
+#include <cassert>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+
+#ifndef unlikely
+#define unlikely(x) __builtin_expect(!!(x), 0)
+#endif
+
+// conversions of the text of a column to the types given to row.as<T>() and to a Schema
+// invalid values fail an assert, like the other errors in the file; std::optional<T> columns also accept empty values
+// numbers can be quoted ("1.5", as written by tools quoting every column), they are then left to from_chars() without their quotes
+// padded values are followed by at least 16 readable bytes, as the columns of a FastCSV row are (the ReadBuffers reserve 64 bytes after buffer_end)
+
+// a calendar date, written YYYY-MM-DD in the file
+struct Date {
+    int year;
+    unsigned month, day;
+
+    bool operator==(const Date &other) const { return year == other.year && month == other.month && day == other.day; }
+    bool operator!=(const Date &other) const { return !(*this == other); }
+};
+
+// a point in time, in nanoseconds since 1970-01-01T00:00:00Z (years 1678 to 2261), written YYYY-MM-DD[T ]hh:mm:ss[.fffffffff][Z|+hh:mm|-hh:mm]
+// in the file, with up to 9 digits of fractional seconds, times without an offset are UTC
+struct Timestamp {
+    int64_t nanoseconds;
+
+    bool operator==(const Timestamp &other) const { return nanoseconds == other.nanoseconds; }
+    bool operator!=(const Timestamp &other) const { return !(*this == other); }
+};
+
+template<class T>
+struct isOptional : std::false_type {
+};
+
+template<class T>
+struct isOptional<std::optional<T>> : std::true_type {
+};
+
+// value of count digits at ptr, false if one of them is not a digit
+static inline bool parseDigits(const char *ptr, int count, unsigned &value) {
+    value = 0;
+    for (int i = 0; i < count; ++i) {
+        const unsigned digit = (unsigned char) ptr[i] - '0';
+        if (digit > 9) return false;
+        value = 10 * value + digit;
+    }
+    return true;
+}
+
+static inline Date parseDate(std::string_view value) {
+    unsigned year = 0, month = 0, day = 0;
+    [[maybe_unused]] const bool valid = value.size() == 10 && value[4] == '-' && value[7] == '-' &&
+                       parseDigits(value.data(), 4, year) && parseDigits(value.data() + 5, 2, month) && parseDigits(value.data() + 8, 2, day);
+    assert(valid && month >= 1 && month <= 12 && day >= 1 && day <= 31 && "column is not a date (YYYY-MM-DD)");
+    return Date{(int) year, month, day};
+}
+
+// days since 1970-01-01 of a date of the proleptic Gregorian calendar (Howard Hinnant's days_from_civil)
+static inline int64_t daysFromCivil(int year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const auto year_of_era = (unsigned) (year - era * 400);
+    const unsigned day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097LL + day_of_era - 719468;
+}
+
+template<class T>
+T parseNumber(std::string_view value) {
+    if (value.size() >= 2 && value.front() == '"' && value.back() == '"') value = value.substr(1, value.size() - 2);
+
+    T result{};
+    [[maybe_unused]] const auto[end, error] = std::from_chars(value.data(), value.data() + value.size(), result);
+    assert(error == std::errc{} && end == value.data() + value.size() && "column is not a number of the requested type");
+    return result;
+}
+
+// value of 8 digits, one per byte (0 to 9, not ASCII), the first one in the lowest byte: 2, then 4, then 8 digits are combined at once (as in simdjson)
+static inline uint64_t eightDigits(uint64_t digits) {
+    digits = digits * 10 + (digits >> 8U);
+    return ((digits & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32U)) + ((digits >> 16U) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32U))) >> 32U;
+}
+
+static constexpr uint64_t ASCII_ZEROS = 0x3030303030303030ULL, HIGH_NIBBLES = 0xF0F0F0F0F0F0F0F0ULL;
+
+// 1 bit in every byte of word that is not a digit: '0' to '9' are 0x30 to 0x39, and adding 6 leaves them below 0x40
+static inline uint64_t nonDigits(uint64_t word) {
+    return ((word & HIGH_NIBBLES) ^ ASCII_ZEROS) | (((word + 0x0606060606060606ULL) & HIGH_NIBBLES) ^ ASCII_ZEROS);
+}
+
+// word with its first count (1 to 8) bytes moved to the end, and '0's before them
+static inline uint64_t alignDigits(uint64_t word, size_t count) {
+    const unsigned shift = 8 * (8 - count);
+    return (word << shift) | (ASCII_ZEROS & ~(~0ULL << shift));
+}
+
+// value of the count (1 to 8) digits at ptr, reading 8 bytes, returns false if one of them is not a digit
+static inline bool swarDigits(const char *ptr, size_t count, uint64_t &value) {
+    uint64_t word;
+    memcpy(&word, ptr, 8);
+
+    // the bytes after the digits are shifted out
+    word = alignDigits(word, count);
+    value = eightDigits(word - ASCII_ZEROS);
+    return !nonDigits(word);
+}
+
+// up to 16 digits of a padded value are read 8 at a time, longer numbers (and their overflow) are left to from_chars()
+template<class T, bool padded>
+T parseInteger(std::string_view value) {
+    const char *ptr = value.data();
+    size_t size = value.size();
+
+    bool negative = false;
+    if constexpr (std::is_signed_v<T>) {
+        if (size && *ptr == '-') {
+            negative = true;
+            ++ptr, --size;
+        }
+    }
+    // the 8 byte reads would go past the end of a value that is not padded, copying it first is slower than from_chars()
+    if (!padded || unlikely(size == 0 || size > 16)) return parseNumber<T>(value);
+
+    uint64_t high = 0, low;
+    bool valid;
+    if (size <= 8) {
+        valid = swarDigits(ptr, size, low);
+    } else {
+        valid = swarDigits(ptr, size - 8, high) & swarDigits(ptr + size - 8, 8, low);
+    }
+
+    // quoted values, and the invalid ones (which then fail its assert), are left to from_chars()
+    const uint64_t magnitude = high * 100000000ULL + low;
+    if (unlikely(!valid || magnitude > (uint64_t) std::numeric_limits<T>::max() + negative)) return parseNumber<T>(value);
+    return negative ? (T) -(int64_t) magnitude : (T) magnitude;
+}
+
+// the 19 bytes of YYYY-MM-DDThh:mm:ss are read as 3 words (bytes 0, 8 and 11), which are checked against the layout and have '0' subtracted at once
+// then every 2 digits are combined in their first byte (as in eightDigits()), where the fields are read
+static inline Timestamp parseTimestamp(std::string_view value) {
+    // per word: the bytes of its digits, and the separators in its other bytes (the 'T' or ' ' between the date and the time is checked on its own)
+    static constexpr uint64_t DIGITS[] = {0x00FFFF00FFFFFFFFULL, 0xFFFF00FFFF00FFFFULL, 0xFFFF00FFFF00FFFFULL}; // YYYY-MM- DDThh:mm hh:mm:ss
+    static constexpr uint64_t SEPARATORS[] = {0xFF0000FF00000000ULL, 0x0000FF0000000000ULL, 0x0000FF0000FF0000ULL};
+    static constexpr uint64_t LAYOUT[] = {0x2D00002D00000000ULL, 0x00003A0000000000ULL, 0x00003A00003A0000ULL};
+
+    // the reads stay inside the column, also when it is not padded: a shorter one is copied first (and then fails the layout check)
+    const char *ptr = value.data();
+    char copy[19]{};
+    if (unlikely(value.size() < 19)) {
+        memcpy(copy, value.data(), value.size());
+        ptr = copy;
+    }
+
+    uint64_t words[3];
+    memcpy(&words[0], ptr, 8);
+    memcpy(&words[1], ptr + 8, 8);
+    memcpy(&words[2], ptr + 11, 8);
+
+    bool valid = value.size() >= 19 && (ptr[10] == 'T' || ptr[10] == ' ');
+    for (int i = 0; i < 3; ++i) {
+        // the separators are replaced by '0's, so that a single subtraction does not borrow from the digits
+        const uint64_t digits = (words[i] & DIGITS[i]) | (ASCII_ZEROS & ~DIGITS[i]);
+        valid &= !nonDigits(digits) && (words[i] & SEPARATORS[i]) == LAYOUT[i];
+
+        const uint64_t values = digits - ASCII_ZEROS;
+        words[i] = values * 10 + (values >> 8U);
+    }
+
+    const auto field = [&](int word, int byte) { return (unsigned) (words[word] >> (8U * byte)) & 0xFFU; };
+    const unsigned year = 100 * field(0, 0) + field(0, 2), month = field(0, 5), day = field(1, 0);
+    const unsigned hour = field(1, 3), minute = field(1, 6), second = field(2, 6);
+    valid &= year >= 1678 && year <= 2261 && month >= 1 && month <= 12 && day >= 1 && day <= 31 && hour <= 23 && minute <= 59 && second <= 59;
+
+    int64_t seconds = (daysFromCivil((int) year, month, day) * 24 + hour) * 3600 + minute * 60 + second;
+    uint64_t nanoseconds = 0;
+
+    // fractional seconds and the offset, after the fixed layout
+    size_t pos = 19;
+    if (pos < value.size() && value[pos] == '.') {
+        unsigned digits = 0, digit;
+        for (++pos; pos < value.size() && (digit = (unsigned char) value[pos] - '0') <= 9; ++pos, ++digits) nanoseconds = 10 * nanoseconds + digit;
+        valid &= digits >= 1 && digits <= 9;
+
+        static constexpr uint64_t SCALE[] = {1000000000, 100000000, 10000000, 1000000, 100000, 10000, 1000, 100, 10, 1};
+        nanoseconds *= SCALE[digits <= 9 ? digits : 9];
+    }
+    if (pos < value.size()) {
+        const char sign = value[pos];
+        unsigned offset_hours = 0, offset_minutes = 0;
+        if (sign == 'Z') {
+            ++pos;
+        } else {
+            valid &= (sign == '+' || sign == '-') && value.size() - pos == 6 && value[pos + 3] == ':' &&
+                     parseDigits(value.data() + pos + 1, 2, offset_hours) && parseDigits(value.data() + pos + 4, 2, offset_minutes);
+            pos = value.size();
+
+            // the time is ahead of UTC by the offset
+            const int64_t offset = offset_hours * 3600 + offset_minutes * 60;
+            seconds -= sign == '-' ? -offset : offset;
+        }
+        valid &= pos == value.size();
+    }
+
+    assert(valid && "column is not a timestamp (YYYY-MM-DDThh:mm:ss[.fffffffff][Z|+hh:mm|-hh:mm])");
+    return Timestamp{seconds * 1000000000 + (int64_t) nanoseconds};
+}
+
+// adds the digits at ptr to mantissa and their number to digits, 8 at a time (reading at most 8 bytes past end), returns the end of the digits
+static inline const char *addDigits(const char *ptr, const char *end, uint64_t &mantissa, int &digits) {
+    static constexpr uint64_t POWERS[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+
+    while (ptr < end) {
+        uint64_t word;
+        memcpy(&word, ptr, 8);
+
+        const uint64_t non_digits = nonDigits(word);
+        const unsigned count = non_digits ? __builtin_ctzll(non_digits) / 8 : 8;
+        if (!count) break;
+
+        // past 19 digits the mantissa overflows, but the number is then given to from_chars()
+        mantissa = mantissa * POWERS[count] + eightDigits(alignDigits(word, count) - ASCII_ZEROS);
+        digits += (int) count;
+        ptr += count;
+        if (count < 8) break;
+    }
+    return ptr;
+}
+
+// decimal numbers without an exponent, with digits that fit in 53 bits for double (24 for float), are parsed with Clinger's fast path:
+// the digits are an exact integer, and so is the power of 10 they are divided by, so the result of the single division is correctly rounded
+// anything else (exponents, long mantissas, inf and nan) is left to from_chars(), which takes the column without a terminator
+// (and is itself an Eisel-Lemire parser in libstdc++ 12 and later)
+template<class T, bool padded>
+T parseFloat(std::string_view value) {
+    static constexpr T POWERS[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    // largest exact integer, and largest exact power of 10
+    constexpr uint64_t MAX_MANTISSA = 1ULL << (std::is_same_v<T, float> ? 24U : 53U);
+    constexpr int MAX_POWER = std::is_same_v<T, float> ? 10 : 22;
+
+    // long double keeps the extra precision of its operations
+    if constexpr (!padded || std::is_same_v<T, long double>) return parseNumber<T>(value);
+
+    const char *ptr = value.data(), *const end = ptr + value.size();
+    const bool negative = ptr != end && *ptr == '-';
+    ptr += negative;
+
+    uint64_t mantissa = 0;
+    int digits = 0, fraction_digits = 0;
+    ptr = addDigits(ptr, end, mantissa, digits);
+    if (ptr < end && *ptr == '.') {
+        const int integer_digits = digits;
+        ptr = addDigits(ptr + 1, end, mantissa, digits);
+        fraction_digits = digits - integer_digits;
+    }
+
+    if (unlikely(ptr != end || !digits || digits > 19 || mantissa > MAX_MANTISSA || fraction_digits > MAX_POWER)) return parseNumber<T>(value);
+
+    const T result = (T) mantissa / POWERS[fraction_digits];
+    return negative ? -result : result;
+}
+
+template<class T, bool padded = false>
+T parseColumn(std::string_view value) {
+    if constexpr (isOptional<T>::value) {
+        if (value.empty()) return std::nullopt;
+        return parseColumn<typename T::value_type, padded>(value);
+    } else if constexpr (std::is_same_v<T, std::string_view>) {
+        return value;
+    } else if constexpr (std::is_same_v<T, Date>) {
+        return parseDate(value);
+    } else if constexpr (std::is_same_v<T, Timestamp>) {
+        return parseTimestamp(value);
+    } else if constexpr (std::is_integral_v<T>) {
+        static_assert(!std::is_same_v<T, bool>, "unsupported column type");
+        return parseInteger<T, padded>(value);
+    } else {
+        static_assert(std::is_floating_point_v<T>, "unsupported column type");
+        return parseFloat<T, padded>(value);
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+enum LineEnding { LF, CRLF };
+
+// the characters of a CSV file, given to FastCSV as a template argument, so they are constants in the SIMD kernels
+// e.g. FastCSV<500, RawReadBuffer, Dialect<'\t'>> for TSV, or Dialect<',', CRLF> for files with Windows line endings
+// with CRLF, rows still end at '\n', the '\r' before it is removed from the last column (rows ending with '\n' only also work)
+// escape == quote is the RFC 4180 way, where "" in a quoted column is one quote
+// any other escape character (e.g. '\\') makes the character after it part of the column, be it a quote, a delimiter or a newline
+template<char delimiter = ',', LineEnding line_ending = LF, char quote = '"', char escape = quote>
+struct Dialect {
+    static constexpr char DELIMITER = delimiter;
+    static constexpr bool CRLF_ENDINGS = line_ending == CRLF;
+    static constexpr char QUOTE = quote;
+    static constexpr char ESCAPE = escape;
+
+    // whether the escape character is a separate one, found by the kernels
+    static constexpr bool SEPARATE_ESCAPE = escape != quote;
+
+    static_assert(delimiter != quote && delimiter != escape, "the delimiter cannot also be the quote or escape character");
+    static_assert(delimiter != '\n' && delimiter != '\r' && quote != '\n' && quote != '\r' && escape != '\n' && escape != '\r',
+                  "line ending characters cannot be used by the dialect");
+    // the kernels read the zeroes after the end of the data
+    static_assert(delimiter != '\0' && quote != '\0' && escape != '\0', "'\\0' cannot be used by the dialect");
+};
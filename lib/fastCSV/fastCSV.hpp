@@ -1,12 +1,18 @@
 #pragma once
 
-#include "rawReadBuffer.hpp"
-
-#ifdef __AVX2__
-
-#include <x86intrin.h>
+#include <array>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
 
-#endif
+#include "rawReadBuffer.hpp"
+#include "kernels.hpp"
+#include "dialect.hpp"
+#include "columnTypes.hpp"
+#include "patterns.hpp"
 
 #ifndef likely
 #define likely(x) __builtin_expect(!!(x), 1)
@@ -15,7 +21,132 @@
 #define unlikely(x) __builtin_expect(!!(x), 0)
 #endif
 
-template<int max_columns, class ReadBuffer = RawReadBuffer>
+// max_columns of a FastCSV object that grows its column table to the widest row, for files with an unknown number of columns
+inline constexpr int DYNAMIC_COLUMNS = 0;
+
+// the columns a FastCSV object records, given to its constructor: FastCSV<500>(path, Projection{3, 7, 12}) or Projection{"id", "price"}
+// row[i] is then the column projection[i] of the file, the others are never looked at
+// names are looked up in the header (the first row)
+struct Projection {
+    std::vector<int> indexes;
+    std::vector<std::string_view> names;
+
+    Projection(std::initializer_list<int> indexes) : indexes{indexes} {}
+    Projection(std::initializer_list<std::string_view> names) : names{names} {}
+    explicit Projection(std::vector<int> indexes) : indexes{std::move(indexes)} {}
+    explicit Projection(std::vector<std::string_view> names) : names{std::move(names)} {}
+};
+
+// a condition on a column, given to FastCSV::setFilter(): the rows that do not match it are then skipped before their columns are copied
+// columns are compared as they are in the file (with their quotes, as row[i] returns them)
+struct Filter {
+    enum Kind { EQUALS, STARTS_WITH, CONTAINS, ROW_CONTAINS, GREP, ANY_OF, CONTAINS_ANY, ROW_CONTAINS_ANY };
+
+    Kind kind = EQUALS;
+    int column = 0; // of the file, also with a projection, negative indexes count from the last column
+    std::string value;
+    KeySet keys; // of ANY_OF
+    AhoCorasick needles; // of CONTAINS_ANY and ROW_CONTAINS_ANY
+
+    Filter() = default;
+    Filter(Kind kind, int column, std::string value, KeySet keys = {}, AhoCorasick needles = {})
+            : kind{kind}, column{column}, value{std::move(value)}, keys{std::move(keys)}, needles{std::move(needles)} {}
+
+    static Filter equals(int column, std::string_view value) { return Filter{EQUALS, column, std::string{value}}; }
+    static Filter startsWith(int column, std::string_view value) { return Filter{STARTS_WITH, column, std::string{value}}; }
+    static Filter contains(int column, std::string_view value) { return Filter{CONTAINS, column, std::string{value}}; }
+    // the whole row (as getRaw() returns it) contains value, which does not need the columns of the row
+    static Filter rowContains(std::string_view value) { return Filter{ROW_CONTAINS, 0, std::string{value}}; }
+    // the same as rowContains(), but the buffer is searched for value with SIMD, and only the rows around its occurrences are indexed and parsed
+    // rows are found from the newlines before and after them, so they must not contain newlines, even quoted or escaped ones
+    static Filter grep(std::string_view value) { return Filter{GREP, 0, std::string{value}}; }
+
+    // many values at once, which replaces a filter per value: the column is one of keys (in a hash table)
+    static Filter anyOf(int column, const std::vector<std::string_view> &keys) { return Filter{ANY_OF, column, {}, KeySet{keys}}; }
+    // the column, or the whole row, contains one of needles (found with an Aho-Corasick automaton in one pass)
+    static Filter containsAny(int column, const std::vector<std::string_view> &needles) { return Filter{CONTAINS_ANY, column, {}, {}, AhoCorasick{needles}}; }
+    static Filter rowContainsAny(const std::vector<std::string_view> &needles) { return Filter{ROW_CONTAINS_ANY, 0, {}, {}, AhoCorasick{needles}}; }
+
+    // the condition is on the whole row, not on a column
+    [[nodiscard]] bool onRow() const { return kind == ROW_CONTAINS || kind == GREP || kind == ROW_CONTAINS_ANY; }
+
+    [[nodiscard]] bool matches(std::string_view text) const {
+        switch (kind) {
+            case EQUALS:
+                return text == value;
+            case STARTS_WITH:
+                return text.substr(0, value.size()) == value;
+            case ANY_OF:
+                return keys.contains(text);
+            case CONTAINS_ANY:
+            case ROW_CONTAINS_ANY:
+                return needles.search(text);
+            default:
+                return text.find(value) != std::string_view::npos;
+        }
+    }
+};
+
+// a batch of rows filled by FastCSV::nextBlock(), with the offsets of the columns stored column by column:
+// the starts of column i of all the rows are contiguous, so that a loop down a single column does not go through the rows
+// the rows stay where they are in the ReadBuffer, and are valid until the next call of nextBlock() or nextRow()
+class RowBlock {
+    template<int, class, class> friend class FastCSV;
+
+public:
+    // the default keeps the offsets of narrow rows in L1/L2 cache, wide rows may need fewer rows per block
+    explicit RowBlock(size_t capacity = 256) : capacity{capacity} {
+        assert(capacity > 0);
+    }
+
+    [[nodiscard]] size_t size() const { return rows; }
+    [[nodiscard]] int getColumns() const { return columns; }
+
+    // returns the whole row, delimiters included
+    [[nodiscard]] std::string_view getRaw(size_t index) const {
+        assert(index < rows);
+        return std::string_view{base + row_begins[index], (size_t) (row_ends[index] - row_begins[index]) - 1};
+    }
+
+    // column of a row, also works with negative column indexes
+    [[nodiscard]] std::string_view get(size_t index, int column) const {
+        if (column < 0) column = columns + column;
+        assert(index < rows && column < columns && column >= 0);
+
+        const uint32_t start = columnStarts(column)[index];
+        return std::string_view{base + start, (size_t) (columnEnds(column)[index] - start) - 1};
+    }
+
+    // converts the column of every row of the block with row.as<T>(), into out[0] to out[size() - 1]
+    template<class T>
+    void as(int column, T *out) const {
+        if (column < 0) column = columns + column;
+        assert(column < columns && column >= 0);
+
+        const uint32_t *const starts = columnStarts(column), *const ends = columnEnds(column);
+        for (size_t i = 0; i < rows; ++i) out[i] = parseColumn<T, true>(std::string_view{base + starts[i], (size_t) (ends[i] - starts[i]) - 1});
+    }
+
+    // size() offsets from data(), of the start of the column in every row, and of its end + 1 (the delimiter or newline after it + 1)
+    // column i of row r is at data() + columnStarts(i)[r], and its size is columnEnds(i)[r] - columnStarts(i)[r] - 1
+    [[nodiscard]] const char *data() const { return base; }
+    [[nodiscard]] const uint32_t *columnStarts(int column) const { return offsets.data() + (size_t) (column << projected) * capacity; }
+    [[nodiscard]] const uint32_t *columnEnds(int column) const { return offsets.data() + (size_t) ((column << projected) + 1) * capacity; }
+
+private:
+    size_t capacity;
+    size_t rows = 0;
+    int columns = 0;
+    int projected = 0; // the same as in FastCSVRow: with a projection, every column has its own start and end
+    int entries = 0; // offsets per row, columns + 1 (the end of the row), or 2 * columns with a projection
+    char *base = nullptr; // start of the first row
+
+    // entries arrays of capacity offsets, the row offsets of FastCSVRow are moved to base and transposed
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> row_begins, row_ends;
+};
+
+template<int max_columns, class ReadBuffer = RawReadBuffer, class CSVDialect = Dialect<>>
 class FastCSV {
     ReadBuffer io{};
 
@@ -28,158 +159,580 @@ public:
         friend class FastCSV;
 
     public:
-        // returns the whole row, ',' included
-        [[nodiscard]] std::string_view getRaw() const { return std::string_view{column[0], (size_t) (column[columns] - column[0]) - 1}; }
+        // returns the whole row, delimiters included
+        [[nodiscard]] std::string_view getRaw() const { return std::string_view{raw_begin, (size_t) (raw_end - raw_begin) - 1}; }
 
         // also works with negative indexes, -1 will get the last element of row
         [[nodiscard]] std::string_view operator[](int index) const {
             if (index < 0) index = columns + index;
             assert(index < columns && index >= 0);
 
-            return std::string_view{column[index], (size_t) (column[index + 1] - column[index]) - 1};
+            index <<= projected; // start and end of every column, with a projection
+            return std::string_view{raw_begin + column[index], (size_t) (column[index + 1] - column[index]) - 1};
+        }
+
+        // the column converted to T: an integer or floating point type, Date, Timestamp, std::string_view, or std::optional of one of these (empty if the column is)
+        template<class T>
+        [[nodiscard]] T as(int index) const { return parseColumn<T, true>((*this)[index]); }
+
+        // returns the column without its enclosing quotes, and with its escapes removed ("" or \" turned into one quote, depending on the Dialect)
+        // storage is only used if the column contains escapes, the result is valid until it changes
+        [[nodiscard]] std::string_view unquote(int index, std::string &storage) const {
+            std::string_view value = (*this)[index];
+            const bool quoted = value.size() >= 2 && value.front() == CSVDialect::QUOTE && value.back() == CSVDialect::QUOTE;
+            if (quoted) value = value.substr(1, value.size() - 2);
+
+            // when quotes are escaped with a quote, only quoted columns have escapes
+            if ((!quoted && !CSVDialect::SEPARATE_ESCAPE) || value.find(CSVDialect::ESCAPE) == std::string_view::npos) return value;
+
+            storage.clear();
+            for (size_t i = 0; i < value.size(); ++i) {
+                if (value[i] == CSVDialect::ESCAPE && i + 1 < value.size()) ++i; // keep the escaped character only
+                storage += value[i];
+            }
+            return storage;
         }
 
         FastCSVRow() = default;
         FastCSVRow(FastCSVRow &) = delete;
         FastCSVRow(FastCSVRow &&) = delete;
     private:
-        int columns = -1; // number of columns in the first row, used to check column number integrity in the document
-        char *column[max_columns + 1]{}; // holds a pointer to the beginning of the element of column X
+        // 32 bit offsets from the start of the row, which take half the space of pointers
+        using ColumnTable = std::conditional_t<max_columns == DYNAMIC_COLUMNS, std::vector<uint32_t>, std::array<uint32_t, max_columns + 1>>;
+
+        int columns = -1; // number of columns in the first row, or in the projection
+        int projected = 0; // 1 if there is a projection, column then holds the start and the end (+ 1) of every projected column
+        char *raw_begin = nullptr, *raw_end = nullptr; // the whole row, as the first and last columns are not always recorded
+        ColumnTable column{}; // holds the offset of the beginning of the element of column X from raw_begin
     } row{};
 
 private:
-#ifdef __AVX2__
-    static inline __attribute__((always_inline, unused)) uint64_t maskForChar(char *ptr, char toFind) {
-        // load
-        __m256i reg_lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr));
-        __m256i reg_hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr + 32));
+    // bytes indexed at once by stage 1, small enough for the data to still be in cache when stage 2 walks it
+    static constexpr size_t INDEX_WINDOW = 16 * 1024;
+
+    // parsing is done in two stages:
+    // stage 1 (SIMD, dispatched once per window) sweeps the next INDEX_WINDOW bytes, and turns the bitmaps of the delimiters and newlines outside quotes
+    // into the offsets of the delimiters from window_base, and for every newline, its offset and the number of delimiters before it
+    // stage 2 (tryParseRow) then gets the columns of a row with a plain copy, without looking at the data or at a bitmap again
+    // the index is restarted from the row start every time the ReadBuffer moves data, so rows always start outside quotes
+    // with a projection, only the first delimiters of a row that are needed for it are stored, the others are only counted
+    struct RowEnd {
+        uint32_t offset; // of the newline
+        uint32_t delimiters; // number of delimiters stored in the window before the newline
+        uint32_t columns; // of the row
+    };
 
-        // compare
-        const __m256i mask = _mm256_set1_epi8(toFind);
-        uint64_t cmp_lo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(reg_lo, mask)));
-        uint64_t cmp_hi = _mm256_movemask_epi8(_mm256_cmpeq_epi8(reg_hi, mask));
+    uint32_t delimiters[INDEX_WINDOW + 16]{}; // + 16, the AVX-512 kernel stores whole vectors of offsets
+    RowEnd row_ends[INDEX_WINDOW]{};
+    size_t delimiter_pos = 0, delimiter_count = 0;
+    size_t row_end_pos = 0, row_end_count = 0;
+    char *window_base = nullptr;
+    size_t window_size = INDEX_WINDOW; // bytes indexed at once, less for a single row found by grep
+    char *index_pos = nullptr; // start of the next 64 byte block to be indexed
+    uint64_t index_in_quotes = 0; // all ones if the next block starts inside a quoted column
+    uint64_t index_escaped = 0; // 1 if the first byte of the next block is escaped
+    uint32_t index_row_delimiters = 0; // delimiters of the row that continues in the next block
+    uint32_t stored_delimiters = UINT32_MAX; // delimiters stored for every row
+
+    int file_columns = -1; // number of columns of every row of the file
+    bool row_in_block = false; // the current row was returned by nextBlock() already
+    bool filtered = false; // rows that do not match filter are skipped
+    bool row_matches = true; // the row parsed in full by tryParseRow<..., true>() matches filter
+    Filter filter;
+    std::vector<int> projection; // columns of the file recorded in the row, in the order of the Projection
+    std::vector<uint32_t> projected_columns; // room to project rows that were parsed in full
+
+    // restarts the index at the start of a row
+    void resetIndex(char *row_begin) {
+        index_pos = row_begin;
+        index_in_quotes = index_escaped = 0;
+        index_row_delimiters = 0;
+        delimiter_pos = delimiter_count = row_end_pos = row_end_count = 0;
+    }
 
-        return cmp_lo | (cmp_hi << 32ULL);
+    // moves the row starting at toKeep to the beginning of the buffer, and reads more data after it
+    // after eof the data stays where it was, so the index stays valid
+    __attribute__((noinline)) void readMore(char *toKeep, size_t toKeepSize) {
+        io.readMore(toKeep, toKeepSize);
+        if (likely(!io.eof)) resetIndex(io.buffer_begin);
     }
 
-    static inline __attribute__((always_inline, unused)) int trailing_zeroes(uint64_t input) {
-#ifdef __BMI2__
-        return (int) _tzcnt_u64(input);
-#else
-        return __builtin_ctzll(input);
+    // stage 1 for the size bytes at window_base, sets delimiter_count and row_end_count
+    template<class Kernel>
+    void indexWindow(size_t size) {
+        // locals, as the stores to the index could otherwise alias the members
+        const char *const base = window_base;
+        uint64_t in_quotes = index_in_quotes, escaped = index_escaped;
+        uint32_t row_delimiters = index_row_delimiters;
+        const uint32_t stored_limit = stored_delimiters;
+        size_t delimiter_total = 0, row_end_total = 0;
+
+        for (size_t offset = 0; offset < size; offset += 64) {
+            BlockMasks masks = Kernel::template masks<CSVDialect>(base + offset);
+
+            // a last partial block (after eof) reads past buffer_end, which is the data of the next range for a ReadBuffer with a byte range
+            if (unlikely(size - offset < 64)) {
+                const uint64_t valid = (1ULL << (size - offset)) - 1ULL;
+                masks.newlines &= valid;
+                masks.delimiters &= valid;
+                masks.quotes &= valid;
+                masks.escapes &= valid;
+            }
+
+            // escaped characters are part of the column
+            if constexpr (CSVDialect::SEPARATE_ESCAPE) {
+                if (unlikely(masks.escapes | escaped)) {
+                    const uint64_t escaped_bits = escapedBits(masks.escapes, escaped);
+                    masks.newlines &= ~escaped_bits;
+                    masks.delimiters &= ~escaped_bits;
+                    masks.quotes &= ~escaped_bits;
+                }
+            }
+
+            uint64_t delimiter_bits = masks.delimiters, newline_bits = masks.newlines;
+
+            // delimiters and newlines inside quoted columns are part of the column
+            // quoted is 1 from an opening quote up to (excluding) its closing quote, an escaped "" toggles twice
+            if (unlikely(masks.quotes | in_quotes)) {
+                const uint64_t quoted = Kernel::prefixXor(masks.quotes) ^ in_quotes;
+                in_quotes = (uint64_t) ((int64_t) quoted >> 63);
+
+                delimiter_bits &= ~quoted;
+                newline_bits &= ~quoted;
+            }
+
+            // once a row has enough delimiters, the next ones are only stored for the rows starting after a newline in this block
+            uint64_t stored_bits = delimiter_bits;
+            if (unlikely(row_delimiters >= stored_limit)) stored_bits &= ~(((newline_bits & -newline_bits) << 1U) - 1ULL);
+
+            for (; newline_bits; newline_bits &= newline_bits - 1ULL) {
+                const int bit = __builtin_ctzll(newline_bits);
+                const uint64_t before = (1ULL << bit) - 1ULL;
+
+                row_delimiters += __builtin_popcountll(delimiter_bits & before);
+                delimiter_bits &= ~before;
+
+                row_ends[row_end_total++] = RowEnd{(uint32_t) (offset + bit), (uint32_t) (delimiter_total + __builtin_popcountll(stored_bits & before)),
+                                                   row_delimiters + 1};
+                row_delimiters = 0;
+            }
+            row_delimiters += __builtin_popcountll(delimiter_bits);
+
+            delimiter_total += Kernel::positions(delimiters + delimiter_total, stored_bits, (uint32_t) offset);
+        }
+
+        index_in_quotes = in_quotes;
+        index_escaped = escaped;
+        index_row_delimiters = row_delimiters;
+        delimiter_count = delimiter_total;
+        row_end_count = row_end_total;
+        delimiter_pos = row_end_pos = 0;
+    }
+
+    // one instantiation of stage 1 per kernel, with every call inlined (flatten) so that the kernel code gets its target
+    __attribute__((flatten)) void indexWindowScalar(size_t size) { indexWindow<ScalarKernel>(size); }
+#ifdef FASTCSV_X86
+    FASTCSV_TARGET_SSE2 __attribute__((flatten)) void indexWindowSse2(size_t size) { indexWindow<Sse2Kernel>(size); }
+    FASTCSV_TARGET_AVX2 __attribute__((flatten)) void indexWindowAvx2(size_t size) { indexWindow<Avx2Kernel>(size); }
+    FASTCSV_TARGET_AVX512 __attribute__((flatten)) void indexWindowAvx512(size_t size) { indexWindow<Avx512Kernel>(size); }
 #endif
+
+    // stage 1 of the kernel picked when this object was created, called once per window and not per row
+    void (FastCSV::*index_window)(size_t) = &FastCSV::indexWindowScalar;
+
+    // the needle search of grep filters, for every kernel
+    __attribute__((flatten)) static const char *findScalar(const char *begin, const char *end, std::string_view needle) {
+        return findNeedle<ScalarKernel>(begin, end, needle);
+    }
+#ifdef FASTCSV_X86
+    FASTCSV_TARGET_SSE2 __attribute__((flatten)) static const char *findSse2(const char *begin, const char *end, std::string_view needle) {
+        return findNeedle<Sse2Kernel>(begin, end, needle);
+    }
+    FASTCSV_TARGET_AVX2 __attribute__((flatten)) static const char *findAvx2(const char *begin, const char *end, std::string_view needle) {
+        return findNeedle<Avx2Kernel>(begin, end, needle);
     }
+    FASTCSV_TARGET_AVX512 __attribute__((flatten)) static const char *findAvx512(const char *begin, const char *end, std::string_view needle) {
+        return findNeedle<Avx512Kernel>(begin, end, needle);
+    }
+#endif
 
-    inline __attribute__((always_inline, unused)) int popcount(uint64_t input) { return __builtin_popcountll(input); }
+    const char *(*find_needle)(const char *, const char *, std::string_view) = &FastCSV::findScalar;
 
-    template<bool first_row = false>
-    void parseNextRow() {
-        if (unlikely(io.eof)) {
-            eos = true;
-            return;
+    void selectKernel() {
+        switch (simd_level) {
+#ifdef FASTCSV_X86
+            case SimdLevel::AVX512:
+                index_window = &FastCSV::indexWindowAvx512;
+                find_needle = &FastCSV::findAvx512;
+                break;
+            case SimdLevel::AVX2:
+                index_window = &FastCSV::indexWindowAvx2;
+                find_needle = &FastCSV::findAvx2;
+                break;
+            case SimdLevel::SSE2:
+                index_window = &FastCSV::indexWindowSse2;
+                find_needle = &FastCSV::findSse2;
+                break;
+#endif
+            default:
+                index_window = &FastCSV::indexWindowScalar;
+                find_needle = &FastCSV::findScalar;
+        }
+    }
+
+    // indexes the next window of the data in the buffer, returns false if all of it was indexed already
+    // before eof, only full blocks are indexed, the bytes after buffer_end are not valid yet
+    __attribute__((noinline)) bool indexMore() {
+        if (index_pos >= io.buffer_end) return false;
+
+        size_t size = io.buffer_end - index_pos;
+        if (!io.eof) size &= ~(size_t) 63;
+        if (!size) return false;
+
+        // after eof, a last partial block is read whole, and indexWindow() ignores its bytes after buffer_end
+        size = std::min(size, window_size);
+        window_base = index_pos;
+        index_pos += (size + 63) & ~(size_t) 63;
+
+        (this->*index_window)(size);
+        return true;
+    }
+
+    // makes room for count entries in the column table
+    void reserveColumns(size_t count) {
+        if constexpr (max_columns == DYNAMIC_COLUMNS) {
+            if (unlikely(count > row.column.size())) row.column.resize(std::max(count, 2 * row.column.size()));
+        } else {
+            assert(count <= max_columns + 1 && "CSV file has more columns than given maximum");
+        }
+    }
+
+    // copies the column starts from the delimiter offsets up to (excluding) end
+    void addColumns(int &current_column, size_t end) {
+        const size_t n = end - delimiter_pos;
+        reserveColumns(current_column + n + 1); // + 1 for the end of the row
+
+        // locals, as the stores to row.column could otherwise alias the members
+        uint32_t *const out = row.column.data() + current_column;
+        const uint32_t *const in = delimiters + delimiter_pos;
+        const uint32_t base = (uint32_t) (window_base - row.raw_begin) + 1; // a column starts after every delimiter
+        for (size_t i = 0; i < n; ++i) out[i] = base + in[i];
+
+        current_column += (int) n;
+        delimiter_pos = end;
+    }
+
+    // moves buff_pos after the newline ending the row, and returns the end of its last column + 1: the newline, or the '\r' before it
+    char *finishRow(char *newline, const char *row_begin) {
+        buff_pos = newline + 1;
+        if constexpr (CSVDialect::CRLF_ENDINGS) {
+            if (newline > row_begin && newline[-1] == '\r') return newline;
+        }
+        return newline + 1;
+    }
+
+    // stage 2 with a projection, for a row that ends in the indexed window: only the projected columns are read from the index
+    void parseProjectedRow() {
+        const RowEnd end = row_ends[row_end_pos++];
+        assert((int) end.columns == file_columns && "CSV file has inconsistent number of columns");
+
+        // a column starts after the delimiter before it, and ends at the one after it
+        const uint32_t *const row_delimiters = delimiters + delimiter_pos;
+        char *const row_begin = buff_pos;
+        const uint32_t base = (uint32_t) (window_base - row_begin) + 1;
+        char *const row_end = finishRow(window_base + end.offset, row_begin);
+        const auto row_size = (uint32_t) (row_end - row_begin);
+        delimiter_pos = end.delimiters;
+
+        uint32_t *const out = row.column.data();
+        const int last_column = file_columns - 1;
+        for (size_t i = 0; i < projection.size(); ++i) {
+            const int index = projection[i];
+            out[2 * i] = index ? base + row_delimiters[index - 1] : 0;
+            out[2 * i + 1] = index < last_column ? base + row_delimiters[index] : row_size;
+        }
+
+        row.raw_begin = row_begin;
+        row.raw_end = row_end;
+    }
+
+    // turns the start of every column of the row into the start and end of the projected ones, for rows that were parsed in full
+    // (the starts of the columns after the last projected one might be missing)
+    void projectRow() {
+        for (size_t i = 0; i < projection.size(); ++i) {
+            projected_columns[2 * i] = row.column[projection[i]];
+            projected_columns[2 * i + 1] = row.column[projection[i] + 1];
+        }
+        std::copy(projected_columns.begin(), projected_columns.end(), row.column.begin());
+    }
+
+    // end of the last column of the row ending at newline (excluding the '\r' before it)
+    char *lastColumnEnd(char *newline, const char *row_begin) const {
+        if constexpr (CSVDialect::CRLF_ENDINGS) {
+            if (newline > row_begin && newline[-1] == '\r') return newline - 1;
+        }
+        return newline;
+    }
+
+    // checks the filter on the row at buff_pos, which ends in the indexed window, from the index only
+    [[nodiscard]] bool indexedRowMatches() const {
+        const RowEnd &end = row_ends[row_end_pos];
+        assert((int) end.columns == file_columns && "CSV file has inconsistent number of columns");
+
+        const char *const row_end = lastColumnEnd(window_base + end.offset, buff_pos);
+        if (filter.onRow()) return filter.matches(std::string_view{buff_pos, (size_t) (row_end - buff_pos)});
+
+        // a column starts after the delimiter before it, and ends at the one after it
+        const uint32_t *const row_delimiters = delimiters + delimiter_pos;
+        const char *const begin = filter.column ? window_base + row_delimiters[filter.column - 1] + 1 : buff_pos;
+        const char *const end_of_column = filter.column < file_columns - 1 ? window_base + row_delimiters[filter.column] : row_end;
+        return filter.matches(std::string_view{begin, (size_t) (end_of_column - begin)});
+    }
+
+    // moves past the row at buff_pos, which ends in the indexed window, without looking at its columns
+    void skipIndexedRow() {
+        const RowEnd end = row_ends[row_end_pos++];
+        delimiter_pos = end.delimiters;
+        buff_pos = window_base + end.offset + 1;
+    }
+
+    // checks the filter on the current row, parsed in full and not projected yet
+    [[nodiscard]] bool parsedRowMatches() const {
+        if (filter.onRow()) return filter.matches(row.getRaw());
+
+        const uint32_t begin = row.column[filter.column];
+        return filter.matches(std::string_view{row.raw_begin + begin, (size_t) (row.column[filter.column + 1] - begin) - 1});
+    }
+
+    // stage 2: parses the row at buff_pos from the index
+    // returns false if the row was moved to the beginning of the buffer to read more data, and has to be parsed again
+    // for the rows of a block after the first one, returns false instead of moving the data, and the block ends before this row
+    // with filtered_row, also sets row_matches
+    template<bool first_row, bool block_row = false, bool filtered_row = false>
+    bool tryParseRow() {
+        // rows that span windows or need more data are parsed in full, and then projected
+        if constexpr (!first_row) {
+            if (row.projected && likely(row_end_pos != row_end_count)) {
+                parseProjectedRow();
+                return true;
+            }
         }
 
-        if (unlikely(buff_pos + 64 >= io.buffer_end && !io.eof)) {
-            assert(io.buffer_end - buff_pos >= 0);
+        int current_column = 0;
+        row.raw_begin = buff_pos;
+        row.column[current_column++] = 0;
+
+        while (unlikely(row_end_pos == row_end_count)) {
+            // the row continues in the next window
+            addColumns(current_column, delimiter_count);
+            if (indexMore()) continue;
+
+            // after eof, the data always ends with a newline, so this is the end of the data
+            // or a quoted column left open, which goes past that newline
+            if (io.eof) {
+                assert(buff_pos >= io.buffer_end && "CSV file ends inside a quoted column");
+                eos = true;
+                return true;
+            }
+
+            // the data stays where it is, the row is indexed again when it is parsed next (as readMore() does not restart the index at eof)
+            if constexpr (block_row) {
+                resetIndex(buff_pos);
+                return false;
+            }
 
             // copy the data for this row to the beginning of the buffer, and read more data after that
-            // io.buffer_end - buff_pos is the number of bytes to be kept in the buffer
-            io.readMore(buff_pos, io.buffer_end - buff_pos);
+            // io.buffer_end - row.raw_begin is the number of bytes to be kept in the buffer
+            readMore(row.raw_begin, io.buffer_end - row.raw_begin);
+
+            // if there are more bytes to process, reset buffer position and reparse this row
             if (likely(!io.eof)) {
                 buff_pos = io.buffer_begin;
+                return false;
             }
+            // else keep going, the rest of the row is already in the buffer and ends with a newline, and the index is still valid
+            // it is guaranteed by io.readMore() that (toKeep, toKeep + toKeepSize) is the same as before the call if io.eof
         }
 
-        int current_column = 0;
-        row.column[current_column++] = buff_pos;
+        const RowEnd end = row_ends[row_end_pos++];
+        addColumns(current_column, end.delimiters);
 
-        while (maskForChar(buff_pos, '\n') == 0ULL) { // if no newline found in the next 64 bytes
-            uint64_t masked_commas = maskForChar(buff_pos, ','); // 1 bit where comma was found
-            const int set_bits = popcount(masked_commas); // count 1 bits
+        // used in size calculation for string_view
+        row.raw_end = finishRow(window_base + end.offset, row.raw_begin);
+        row.column[current_column] = (uint32_t) (row.raw_end - row.raw_begin);
 
-            // process all comma locations
-            for (int i = 0; i < set_bits; i++) {
-                row.column[current_column++] = buff_pos + 1 + trailing_zeroes(masked_commas);
-                masked_commas = masked_commas & (masked_commas - 1ULL); // remove trailing 1 bit
-            }
+        if constexpr (first_row) row.columns = file_columns = current_column;
+        assert((int) end.columns == file_columns && "CSV file has inconsistent number of columns");
 
-            buff_pos += 64;
+        if constexpr (filtered_row) row_matches = !filtered || parsedRowMatches();
+        if constexpr (!first_row) {
+            if (row.projected) projectRow();
+        }
+        return true;
+    }
 
-            // if next step would exit
-            if (unlikely(buff_pos + 64 >= io.buffer_end)) {
-                // this should not be the first row (increase buffer space if this assert fails)
-                if constexpr (first_row) assert(false);
+    template<bool first_row = false>
+    void parseNextRow() {
+        row_in_block = false;
+        if constexpr (!first_row) {
+            if (unlikely(filtered)) return parseNextMatch();
+        }
+        while (!tryParseRow<first_row>());
+    }
 
-                // copy the data for this row to the beginning of the buffer, and read more data after that
-                // io.buffer_end - row.column[0] is the number of bytes to be kept in the buffer
-                io.readMore(row.column[0], io.buffer_end - row.column[0]);
+    // parses the next row that matches the filter, the rows ending in the indexed window are checked from the index, without copying their columns
+    void parseNextMatch() {
+        if (filter.kind == Filter::GREP) return parseNextGrepMatch();
 
-                // if there are more bytes to process, reset buffer position and reparse this row
-                if (likely(!io.eof)) {
-                    buff_pos = io.buffer_begin;
-                    return parseNextRow();
+        for (;;) {
+            while (likely(row_end_pos != row_end_count)) {
+                if (indexedRowMatches()) {
+                    tryParseRow<false>();
+                    return;
                 }
-                // else exit while
-                // it is guaranteed by io.readMore() that (toKeep, toKeep + toKeepSize) is the same as before the call if io.eof
-                break;
+                skipIndexedRow();
             }
+
+            // the row continues in the next window, it is parsed in full
+            while (!tryParseRow<false, false, true>());
+            if (eos || row_matches) return;
         }
+    }
 
-        // manually process last bytes
-        int new_pos = trailing_zeroes(maskForChar(buff_pos, '\n'));
-        for (int offset = 0; offset < new_pos; ++offset)
-            if (buff_pos[offset] == ',') row.column[current_column++] = buff_pos + offset + 1;
-        buff_pos += new_pos;
+    // searches the data from buff_pos for the value of the grep filter, and parses the row around the first occurrence
+    // the data before it is never indexed, and only the row is (the index is restarted at its beginning)
+    void parseNextGrepMatch() {
+        const std::string_view needle = filter.value;
 
-        // this is the start of the next row, used in size calculation for string_view
-        row.column[current_column] = ++buff_pos; // also skip newline
+        for (;;) {
+            const char *const match = find_needle(buff_pos, io.buffer_end, needle);
 
-        if constexpr (first_row) row.columns = current_column;
-        assert(row.columns == current_column && "CSV file has inconsistent number of columns");
+            if (match) {
+                // the row starts after the newline before the match
+                char *row_begin = buff_pos + (match - buff_pos);
+                while (row_begin > buff_pos && row_begin[-1] != '\n') --row_begin;
+
+                // only the row is indexed if it ends in the buffer, or else as much as usual, as the data will be moved
+                const auto *const newline = static_cast<const char *>(memchr(match, '\n', io.buffer_end - match));
+                window_size = newline ? std::min(INDEX_WINDOW, (size_t) (newline + 1 - row_begin + 63) & ~(size_t) 63) : INDEX_WINDOW;
+
+                buff_pos = row_begin;
+                resetIndex(buff_pos);
+                while (!tryParseRow<false>());
+
+                window_size = INDEX_WINDOW;
+                return;
+            }
+
+            // no match up to the end of the data, which ends with a newline at eof
+            if (io.eof) {
+                buff_pos = io.buffer_end;
+                eos = true;
+                return;
+            }
+
+            // the last row may continue after buffer_end, it is kept and searched again with the next data
+            const auto *const last_newline = static_cast<const char *>(memrchr(buff_pos, '\n', io.buffer_end - buff_pos));
+            char *const last_row = last_newline ? buff_pos + (last_newline + 1 - buff_pos) : buff_pos;
+            readMore(last_row, io.buffer_end - last_row);
+            buff_pos = io.eof ? last_row : io.buffer_begin;
+        }
     }
-#else
-    template<bool first_row = false>
-    void parseNextRow() {
-        if (unlikely(io.eof)) {
-            eos = true;
-            return;
+
+    // adds the current row to the block
+    void addToBlock(RowBlock &block) {
+        const size_t index = block.rows++;
+        if (!index) block.base = row.raw_begin;
+
+        assert((size_t) (row.raw_end - block.base) <= UINT32_MAX && "rows of a block span more than 4GB");
+        const auto begin = (uint32_t) (row.raw_begin - block.base);
+        block.row_begins[index] = begin;
+        block.row_ends[index] = (uint32_t) (row.raw_end - block.base);
+
+        uint32_t *const out = block.offsets.data() + index;
+        for (int i = 0; i < block.entries; ++i) out[i * block.capacity] = begin + row.column[i];
+    }
+
+    // stage 2 for a row of a block that ends in the indexed window: its columns are copied from the index straight into the block
+    void parseBlockRow(RowBlock &block) {
+        const RowEnd end = row_ends[row_end_pos++];
+        assert((int) end.columns == file_columns && "CSV file has inconsistent number of columns");
+
+        const size_t index = block.rows++;
+        char *const row_begin = buff_pos;
+        char *const row_end = finishRow(window_base + end.offset, row_begin);
+        assert((size_t) (row_end - block.base) <= UINT32_MAX && "rows of a block span more than 4GB");
+
+        // locals, as the stores to the block could otherwise alias the members
+        const auto begin = (uint32_t) (row_begin - block.base), end_offset = (uint32_t) (row_end - block.base);
+        const uint32_t base = (uint32_t) (window_base - block.base) + 1; // a column starts after every delimiter
+        const uint32_t *const row_delimiters = delimiters + delimiter_pos;
+        uint32_t *const out = block.offsets.data() + index;
+        const size_t stride = block.capacity;
+        const int columns = file_columns;
+        delimiter_pos = end.delimiters;
+
+        if (row.projected) {
+            const int *const projected = projection.data();
+            const size_t count = projection.size();
+            for (size_t i = 0; i < count; ++i) {
+                const int column = projected[i];
+                out[2 * i * stride] = column ? base + row_delimiters[column - 1] : begin;
+                out[(2 * i + 1) * stride] = column < columns - 1 ? base + row_delimiters[column] : end_offset;
+            }
+        } else {
+            out[0] = begin;
+            for (int i = 1; i < columns; ++i) out[i * stride] = base + row_delimiters[i - 1];
+            out[columns * stride] = end_offset;
         }
 
-        int current_column = 0;
-        row.column[current_column++] = buff_pos;
+        block.row_begins[index] = begin;
+        block.row_ends[index] = end_offset;
+    }
 
-        while (*buff_pos != '\n') {
-            // mark the start of a new column right after the ','
-            if (*buff_pos == ',') row.column[current_column++] = buff_pos + 1;
+    // the last row of the block becomes the current row
+    void restoreFromBlock(const RowBlock &block) {
+        const size_t index = block.rows - 1;
+        const uint32_t begin = block.row_begins[index];
 
-            ++buff_pos;
+        row.raw_begin = block.base + begin;
+        row.raw_end = block.base + block.row_ends[index];
+        for (int i = 0; i < block.entries; ++i) row.column[i] = block.offsets[i * block.capacity + index] - begin;
+    }
 
-            if (unlikely(buff_pos + 1 >= io.buffer_end)) {
-                // this should not be the first row (increase buffer space if this assert fails)
-                if constexpr (first_row) assert(false);
+    // picks the kernel and parses the first row, which sets the number of columns
+    void parseFirstRow() {
+        selectKernel();
+        resetIndex(io.buffer_begin);
+        reserveColumns(1);
+        parseNextRow<true>();
+    }
 
-                // copy the data for this row to the beginning of the buffer, and read more data after that
-                // io.buffer_end - row.column[0] is the number of bytes to be kept in the buffer
-                io.readMore(row.column[0], io.buffer_end - row.column[0]);
+    // sets the projection, after the first row was parsed, which is then projected too
+    void project(const Projection &args) {
+        if (eos) return; // no rows, and no header to look up names in
 
-                // if there are more bytes to process, reset buffer position and reparse this row
-                if (likely(!io.eof)) {
-                    buff_pos = io.buffer_begin;
-                    return parseNextRow();
-                }
-                // else exit while
-                // it is guaranteed by io.readMore() that (toKeep, toKeep + toKeepSize) is the same as before the call if io.eof
-                break;
-            }
+        projection = args.indexes;
+        for (std::string_view name : args.names) {
+            int index = 0;
+            while (index < file_columns && row[index] != name) ++index;
+            assert(index < file_columns && "column of the projection is not in the header");
+            projection.push_back(index);
         }
 
-        // this is the start of the next row, used in size calculation for string_view
-        row.column[current_column] = ++buff_pos; // also skip newline
+        assert(!projection.empty() && "projection has no columns");
+        for ([[maybe_unused]] int index : projection) assert(index >= 0 && index < file_columns && "column of the projection is not in the file");
+        if constexpr (max_columns != DYNAMIC_COLUMNS) assert(2 * projection.size() <= max_columns + 1 && "projection has too many columns for max_columns");
+        reserveColumns(2 * projection.size());
 
-        if constexpr (first_row) row.columns = current_column;
-        assert(row.columns == current_column && "CSV file has inconsistent number of columns");
+        projected_columns.resize(2 * projection.size());
+        projectRow();
+
+        // the start of the column after the last projected one is its end
+        stored_delimiters = *std::max_element(projection.begin(), projection.end()) + 1;
+        row.projected = 1;
+        row.columns = (int) projection.size();
     }
-#endif
 
     struct sentinel {
     };
@@ -187,10 +740,7 @@ private:
 public:
     explicit FastCSV(const char *path, const std::initializer_list<std::pair<std::string_view, int &>> &&header_args = {})
             : io{path}, buff_pos{io.buffer_begin} {
-        parseNextRow<true>();
-
-        // make sure that max_columns were enough
-        assert(row.columns < max_columns + 1 && "CSV file has more columns than given maximum");
+        parseFirstRow();
 
         // parse header column names
         if (header_args.size()) {
@@ -205,10 +755,110 @@ public:
             }
         }
     }
+
+    // passes any extra arguments to the ReadBuffer, e.g. a byte range of the file: FastCSV<500, MmapReadBuffer>(path, begin, end)
+    // the first row is not treated as a header
+    template<class... ReadBufferArgs>
+    explicit FastCSV(const char *path, ReadBufferArgs &&... read_buffer_args)
+            : io{path, std::forward<ReadBufferArgs>(read_buffer_args)...}, buff_pos{io.buffer_begin} {
+        parseFirstRow();
+    }
+
+    // only records the columns of the projection, the other arguments are passed to the ReadBuffer
+    template<class... ReadBufferArgs>
+    explicit FastCSV(const char *path, Projection projection, ReadBufferArgs &&... read_buffer_args)
+            : io{path, std::forward<ReadBufferArgs>(read_buffer_args)...}, buff_pos{io.buffer_begin} {
+        parseFirstRow();
+        project(projection);
+    }
     FastCSV(FastCSV &) = delete;
     FastCSV(FastCSV &&) = delete;
 
     void nextRow() { parseNextRow(); }
+
+    // parses rows into block, starting with the current row (unless the previous block ended with it), so blocks visit the same rows as a for loop
+    // up to the capacity of the block, but a block ends early before a row that needs more data to be read, as its rows have to stay in the buffer
+    // the last row of the block becomes the current row, returns false at the end of the file (the block is then empty)
+    bool nextBlock(RowBlock &block) {
+        block.rows = 0;
+        block.columns = row.columns;
+        block.projected = row.projected;
+        block.entries = row.projected ? 2 * row.columns : row.columns + 1;
+        block.offsets.resize(block.entries * block.capacity);
+        block.row_begins.resize(block.capacity);
+        block.row_ends.resize(block.capacity);
+
+        if (row_in_block && !eos) parseNextRow();
+        if (eos) return false;
+
+        addToBlock(block);
+        while (block.rows < block.capacity) {
+            if (likely(row_end_pos != row_end_count)) {
+                if (unlikely(filtered) && !indexedRowMatches()) skipIndexedRow();
+                else parseBlockRow(block);
+                continue;
+            }
+
+            // the row continues in the next window, it is parsed as usual, unless it needs more data
+            if (!tryParseRow<false, true, true>() || eos) break;
+            if (row_matches) addToBlock(block);
+        }
+
+        restoreFromBlock(block);
+        row_in_block = true;
+        return true;
+    }
+
+    // from the next row on, nextRow(), for loops and nextBlock() only visit the rows that match filter
+    // the others are checked from the index of the delimiters, and skipped without copying their columns
+    void setFilter(Filter new_filter) {
+        if (new_filter.column < 0) new_filter.column += file_columns;
+        assert((new_filter.onRow() || (new_filter.column >= 0 && new_filter.column < file_columns)) && "column of the filter is not in the file");
+
+        filter = std::move(new_filter);
+        filtered = true;
+
+        // with a projection, the delimiters of the rows are only stored up to the last projected column, and now up to the filtered one too
+        // the rows after this one are then indexed again
+        assert((filter.kind != Filter::GREP || (!filter.value.empty() && filter.value.find('\n') == std::string::npos)) && "grep needs a value without newlines");
+        if (row.projected && !filter.onRow() && (uint32_t) filter.column + 1 > stored_delimiters) {
+            stored_delimiters = filter.column + 1;
+            resetIndex(buff_pos);
+        }
+    }
+
+    // visits every row again, from the next one on
+    void clearFilter() { filtered = false; }
+
+    // makes row n of the file the current row (0 is the first row, the header if there is one), or finishes if the file has n rows or less
+    // index is the RowIndex of the file (rowIndex.hpp): the ReadBuffer seeks to the last indexed row before n, which needs ReadBuffer::seek()
+    // and the rows after it are skipped from the index of the delimiters, the filter does not apply to them
+    template<class Index>
+    void seekToRow(const Index &index, uint64_t n) {
+        row_in_block = false;
+        if (n >= index.rows) {
+            buff_pos = io.buffer_end;
+            eos = true;
+            return;
+        }
+
+        const auto [indexed_row, offset] = index.rowBefore(n);
+        io.seek(offset);
+        buff_pos = io.buffer_begin;
+        eos = false;
+        resetIndex(buff_pos);
+
+        for (uint64_t skipped = indexed_row; skipped < n;) {
+            if (likely(row_end_pos != row_end_count)) {
+                skipIndexedRow();
+                ++skipped;
+            } else if (tryParseRow<false>()) {
+                ++skipped;
+            }
+        }
+        while (!tryParseRow<false>());
+    }
+
     [[nodiscard]] const FastCSVRow &getRow() const { return row; }
     [[nodiscard]] bool finished() const { return eos; }
     [[nodiscard]] int getColumns() const { return row.columns; }
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#include "../zlib/zlib.h"
+
+// random access into a gzip file (like zlib's examples/zran.c): inflate checkpoints recorded every SPAN bytes of output
+// a checkpoint holds the position in the compressed file of a deflate block start, and the 32KB of output before it
+// inflating can resume at any checkpoint with inflatePrime() and inflateSetDictionary()
+// the index is built once with a full serial inflate, and saved next to the file as <path>.fcidx
+class GzipIndex {
+public:
+    static constexpr size_t SPAN = 8 * (1U << 20U);
+    static constexpr size_t WINDOW_SIZE = 32768;
+
+    struct Point {
+        uint64_t out = 0; // offset in the inflated data
+        uint64_t in = 0; // offset in the compressed file of the first full byte of the block
+        int bits = 0; // number of bits of the block in the byte before in, if any
+        std::vector<uint8_t> window; // the WINDOW_SIZE bytes of output before this point, deflated
+    };
+
+    uint64_t size = 0; // size of the inflated data
+    std::vector<Point> points;
+
+    // returns the index of the file, loaded from its sidecar file, or built (and saved, if possible)
+    // indexes are cached, so readers of the same file on several threads share one
+    static std::shared_ptr<const GzipIndex> open(const char *path) {
+        static std::mutex mutex;
+        static std::map<std::string, std::shared_ptr<const GzipIndex>> cache;
+
+        std::lock_guard lock{mutex};
+        auto &index = cache[path];
+
+        if (!index) {
+            const std::string index_path = std::string{path} + ".fcidx";
+
+            struct stat file_stat{};
+            [[maybe_unused]] const int stat_result = stat(path, &file_stat);
+            assert(stat_result == 0);
+
+            auto loaded = std::make_shared<GzipIndex>();
+            if (!loaded->load(index_path.c_str(), file_stat)) {
+                loaded->build(path);
+                loaded->save(index_path.c_str(), file_stat); // only an optimisation, ignore failures (e.g. read-only directory)
+            }
+            index = std::move(loaded);
+        }
+
+        return index;
+    }
+
+    // last point at or before the given offset of the inflated data
+    [[nodiscard]] const Point &pointBefore(uint64_t offset) const {
+        assert(!points.empty() && points.front().out == 0);
+
+        size_t low = 0, high = points.size();
+        while (high - low > 1) {
+            size_t middle = (low + high) / 2;
+            if (points[middle].out <= offset) low = middle;
+            else high = middle;
+        }
+
+        return points[low];
+    }
+
+    // inflates the window of the point, returns its size
+    static size_t window(const Point &point, uint8_t *window) {
+        uLongf size = WINDOW_SIZE;
+        [[maybe_unused]] const int status = uncompress(window, &size, point.window.data(), point.window.size());
+        assert(status == Z_OK);
+        return size;
+    }
+
+private:
+    // identifies the sidecar format, and the gzip file it was built for
+    struct Header {
+        char magic[8];
+        uint64_t file_size;
+        int64_t file_mtime;
+        uint64_t size;
+        uint64_t points;
+    };
+    static constexpr char MAGIC[8] = {'F', 'C', 'S', 'V', 'G', 'Z', 'I', '1'};
+
+    void addPoint(z_stream &inflator, uint64_t in, uint64_t out) {
+        uint8_t window[WINDOW_SIZE];
+        uInt window_size = WINDOW_SIZE;
+        [[maybe_unused]] int status = inflateGetDictionary(&inflator, window, &window_size);
+        assert(status == Z_OK);
+
+        Point &point = points.emplace_back();
+        point.out = out;
+        point.in = in;
+        point.bits = inflator.data_type & 7;
+
+        uLongf compressed_size = compressBound(window_size);
+        point.window.resize(compressed_size);
+        status = compress2(point.window.data(), &compressed_size, window, window_size, 1);
+        assert(status == Z_OK);
+        point.window.resize(compressed_size);
+    }
+
+    // inflates the whole file, stopping at every deflate block boundary
+    void build(const char *path) {
+        int fd = ::open(path, O_RDONLY);
+        assert(fd != -1);
+
+        static constexpr size_t RAW_SIZE = 1U << 16U;
+        static constexpr size_t OUT_SIZE = 1U << 18U;
+        std::unique_ptr<uint8_t[]> raw{new uint8_t[RAW_SIZE]}, out{new uint8_t[OUT_SIZE]};
+
+        z_stream inflator{};
+        // + 16 for gzip header & footer parsing
+        [[maybe_unused]] int status = inflateInit2(&inflator, 15 + 16);
+        assert(status == Z_OK);
+
+        uint64_t total_in = 0, total_out = 0, last_point = 0;
+        bool member_end = false;
+
+        while (true) {
+            if (inflator.avail_in == 0) {
+                int readSize = read(fd, raw.get(), RAW_SIZE);
+                assert(readSize != -1);
+                if (readSize == 0) break;
+
+                inflator.avail_in = readSize;
+                inflator.next_in = raw.get();
+            }
+
+            // raw data left after the end of a gzip member means this is an appended file
+            if (member_end) {
+                status = inflateReset(&inflator);
+                assert(status == Z_OK);
+                member_end = false;
+            }
+
+            inflator.avail_out = OUT_SIZE;
+            inflator.next_out = out.get();
+
+            const uInt avail_in = inflator.avail_in;
+            status = inflate(&inflator, Z_BLOCK);
+            assert(status == Z_OK || status == Z_STREAM_END);
+
+            total_in += avail_in - inflator.avail_in;
+            total_out += OUT_SIZE - inflator.avail_out;
+            member_end = status == Z_STREAM_END;
+
+            // at the end of a deflate block header, which is not the last one
+            if ((inflator.data_type & 128) && !(inflator.data_type & 64) &&
+                (points.empty() || total_out - last_point >= SPAN)) {
+                addPoint(inflator, total_in, total_out);
+                last_point = total_out;
+            }
+        }
+
+        status = inflateEnd(&inflator);
+        assert(status == Z_OK);
+        [[maybe_unused]] const int close_result = close(fd);
+        assert(close_result == 0);
+
+        size = total_out;
+    }
+
+    bool save(const char *index_path, const struct stat &file_stat) const {
+        FILE *file = fopen(index_path, "wb");
+        if (!file) return false;
+
+        Header header{};
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.file_size = file_stat.st_size;
+        header.file_mtime = file_stat.st_mtime;
+        header.size = size;
+        header.points = points.size();
+
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        for (const Point &point : points) {
+            const uint64_t fields[4] = {point.out, point.in, (uint64_t) point.bits, point.window.size()};
+            ok = ok && fwrite(fields, sizeof(fields), 1, file) == 1;
+            ok = ok && fwrite(point.window.data(), point.window.size(), 1, file) == 1;
+        }
+
+        ok = fclose(file) == 0 && ok;
+        if (!ok) unlink(index_path);
+        return ok;
+    }
+
+    // fails if the sidecar file is missing, or was built for another version of the gzip file
+    bool load(const char *index_path, const struct stat &file_stat) {
+        FILE *file = fopen(index_path, "rb");
+        if (!file) return false;
+
+        Header header{};
+        bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                  header.file_size == (uint64_t) file_stat.st_size && header.file_mtime == file_stat.st_mtime;
+
+        if (ok) {
+            size = header.size;
+            points.resize(header.points);
+
+            for (Point &point : points) {
+                uint64_t fields[4];
+                ok = ok && fread(fields, sizeof(fields), 1, file) == 1 && fields[3] <= compressBound(WINDOW_SIZE);
+                if (!ok) break;
+
+                point.out = fields[0];
+                point.in = fields[1];
+                point.bits = (int) fields[2];
+                point.window.resize(fields[3]);
+                ok = fread(point.window.data(), point.window.size(), 1, file) == 1;
+            }
+        }
+
+        fclose(file);
+        if (!ok) points.clear();
+        return ok;
+    }
+};
@@ -6,8 +6,11 @@
 #include <unistd.h>
 #include <cassert>
 #include <cstring>
+#include <algorithm>
+#include <memory>
 
 #include "../zlib/zlib.h"
+#include "gzipIndex.hpp"
 
 #ifndef unlikely
 #define unlikely(x) __builtin_expect(!!(x), 0)
@@ -25,11 +28,53 @@ private:
     uint8_t *raw_begin = raw_buffer;
     uint8_t *raw_end = raw_buffer;
 
-    char buffer[BUFF_SIZE_TOTAL + 64]{};
+    // + 1 for the newline appended to an unterminated last row, + 64 zeroed bytes for SIMD reads past buffer_end
+    // starts at BUFF_SIZE_TOTAL bytes, and doubles whenever a row fills more than half of it
+    size_t buffer_size = BUFF_SIZE_TOTAL;
+    std::unique_ptr<char[]> storage{new char[BUFF_SIZE_TOTAL + 1 + 64]{}};
+    char *buffer = storage.get();
 
     z_stream inflator{};
     bool zlib_eos = false;
 
+    // when started from an index point, the first member is inflated as a raw deflate stream, and its trailer skipped
+    bool raw_deflate = false;
+    size_t trailer_left = 0;
+
+    // offset in the inflated data of buffer_end, and end of the range of rows to be read
+    uint64_t out_offset = 0;
+    uint64_t range_end = UINT64_MAX;
+    bool range_done = false;
+
+    void readRaw() {
+        int readSize = read(fd, raw_buffer, BUFF_SIZE_RAW);
+        assert(readSize != -1);
+
+        // update pointers
+        raw_begin = raw_buffer;
+        raw_end = raw_buffer + readSize;
+    }
+
+    // no more data, toKeep data (which always ends at buffer_end) is left in place
+    void finish(size_t toKeepSize) {
+        eof = true;
+
+        // terminate the last row if the file does not end with a newline
+        if (toKeepSize && buffer_end[-1] != '\n') *buffer_end++ = '\n';
+
+        memset(buffer_end, 0, 64); // clear last 64 bytes
+    }
+
+    // replaces the buffer with one twice as large, starting with the toKeep data
+    void grow(char *&toKeep, size_t toKeepSize) {
+        std::unique_ptr<char[]> grown{new char[2 * buffer_size + 1 + 64]};
+        memcpy(grown.get(), toKeep, toKeepSize);
+
+        storage = std::move(grown);
+        buffer = buffer_begin = toKeep = storage.get();
+        buffer_size *= 2;
+    }
+
 public:
     char *buffer_begin = buffer;
     char *buffer_end = buffer;
@@ -42,45 +87,132 @@ public:
         assert(fd != -1);
 
         // + 16 for gzip header & footer parsing
-        assert(inflateInit2(&inflator, 15 + 16) == 0);
+        [[maybe_unused]] const int status = inflateInit2(&inflator, 15 + 16);
+        assert(status == Z_OK);
 
-        readMore(nullptr, 0);
+        readMore(buffer, 0);
+    }
+
+    // only read the rows starting in the byte range [begin, end) of the inflated data, with the same rules as MmapReadBuffer
+    // inflating starts from the closest GzipIndex point, the index is built first if needed
+    GzipReadBuffer(const char *path, size_t begin, size_t end) {
+        fd = open(path, O_RDONLY);
+        assert(fd != -1 && begin <= end);
+
+        range_end = end;
+        if (end == 0) {
+            // inflator is still initialised for the destructor
+            [[maybe_unused]] const int status = inflateInit2(&inflator, 15 + 16);
+            assert(status == Z_OK);
+            finish(0);
+            return;
+        }
+
+        if (begin == 0) {
+            // + 16 for gzip header & footer parsing
+            [[maybe_unused]] const int status = inflateInit2(&inflator, 15 + 16);
+            assert(status == Z_OK);
+            readMore(buffer, 0);
+            return;
+        }
+
+        // resume inflating at the point before the byte preceding the range
+        const auto index = GzipIndex::open(path);
+        const GzipIndex::Point &point = index->pointBefore(begin - 1);
+
+        [[maybe_unused]] int status = inflateInit2(&inflator, -15);
+        assert(status == Z_OK);
+        raw_deflate = true;
+
+        [[maybe_unused]] const off_t position = lseek(fd, (off_t) (point.in - (point.bits ? 1 : 0)), SEEK_SET);
+        assert(position != -1);
+        if (point.bits) {
+            uint8_t byte = 0;
+            [[maybe_unused]] const ssize_t byte_read = read(fd, &byte, 1);
+            assert(byte_read == 1);
+            status = inflatePrime(&inflator, point.bits, byte >> (8 - point.bits));
+            assert(status == Z_OK);
+        }
+
+        uint8_t window[GzipIndex::WINDOW_SIZE];
+        const size_t window_size = GzipIndex::window(point, window);
+        status = inflateSetDictionary(&inflator, window, window_size);
+        assert(status == Z_OK);
+        out_offset = point.out;
+
+        // discard data up to the newline ending the row which contains byte begin - 1
+        while (!eof) {
+            readMore(buffer, 0);
+            if (out_offset < begin) continue;
+
+            char *from = buffer_end - (out_offset - std::max<uint64_t>(begin - 1, out_offset - (buffer_end - buffer)));
+            auto newline = (char *) memchr(from, '\n', buffer_end - from);
+            if (!newline) continue;
+
+            // the rows of the range start after it
+            const size_t rest = buffer_end - (newline + 1);
+            memmove(buffer, newline + 1, rest);
+            buffer_end = buffer + rest;
+
+            if (range_done) finish(rest);
+            return;
+        }
+
+        // the range is inside the last row
+        buffer_end = buffer;
+        finish(0);
+    }
+
+    // size of the inflated data, ranges are given as offsets into it
+    static size_t dataSize(const char *path) {
+        return GzipIndex::open(path)->size;
     }
 
     // close the file when this object is deleted
     ~GzipReadBuffer() {
-        assert(close(fd) == 0);
-        assert(inflateEnd(&inflator) == 0);
+        [[maybe_unused]] const int close_result = close(fd);
+        assert(close_result == 0);
+        [[maybe_unused]] const int status = inflateEnd(&inflator);
+        assert(status == Z_OK);
     }
 
     // read bytes from file, and write to buffer + starting_from
     // sets eof = true when there are no more bytes to be read
+    // after eof, toKeep data stays where it was, ends with a newline and is followed by 64 zero bytes
     void readMore(char *toKeep, size_t toKeepSize) {
+        // the last row of the range was already inflated
+        if (unlikely(range_done)) {
+            finish(toKeepSize);
+            return;
+        }
+
         // fetch more raw data if needed
-        if (raw_begin == raw_end) {
-            int readSize = read(fd, raw_buffer, BUFF_SIZE_RAW);
-            assert(readSize != -1);
+        if (raw_begin == raw_end) readRaw();
+
+        // skip the gzip trailer after a raw deflate stream
+        while (unlikely(trailer_left) && raw_begin != raw_end) {
+            const size_t skipSize = std::min<size_t>(trailer_left, raw_end - raw_begin);
+            raw_begin += skipSize;
+            trailer_left -= skipSize;
 
-            // update pointers
-            raw_begin = raw_buffer;
-            raw_end = raw_buffer + readSize;
+            if (raw_begin == raw_end) readRaw();
         }
 
         // eof if inflator reported done last time && no more raw data left
         if (unlikely(zlib_eos)) {
-            if (raw_begin != raw_end) { // appended file
-                assert(inflateReset(&inflator) == 0);
+            if (raw_begin != raw_end) { // appended file (also switches a raw deflate inflator back to gzip)
+                [[maybe_unused]] const int status = inflateReset2(&inflator, 15 + 16);
+                assert(status == Z_OK);
             } else {
-                eof = true;
-                memset(buffer_end, 0, 64); // clear last 64 bytes
-
-                // we still need to copy toKeep data
-                memmove(buffer, toKeep, toKeepSize);
-                buffer_end = buffer + toKeepSize;
+                finish(toKeepSize);
                 return;
             }
         }
 
+        // a row filling more than half of the buffer is moved to one twice as large, so that every call adds at least as many bytes
+        // as are kept, and a long row is re-parsed O(log(size)) times, not O(size / BUFF_SIZE_TOTAL) times
+        if (unlikely(toKeepSize > buffer_size / 2)) grow(toKeep, toKeepSize);
+
         // copy toKeep data exactly before the data we'll read below
         memmove(buffer, toKeep, toKeepSize);
         buffer_end = buffer + toKeepSize;
@@ -89,17 +221,36 @@ public:
         inflator.avail_in = raw_end - raw_begin;
         inflator.next_in = raw_begin;
 
-        inflator.avail_out = BUFF_SIZE_TOTAL - toKeepSize;
+        inflator.avail_out = buffer_size - toKeepSize;
         inflator.next_out = (uint8_t *) buffer_end;
 
         int status = inflate(&inflator, Z_SYNC_FLUSH);
         assert(status == Z_OK || status == Z_STREAM_END);
         zlib_eos = status;
 
+        if (unlikely(zlib_eos && raw_deflate)) {
+            raw_deflate = false;
+            trailer_left = 8;
+        }
+
         // the difference between the original available size and the available size after the call is the size of written bytes
-        buffer_end += (BUFF_SIZE_TOTAL - toKeepSize) - inflator.avail_out;
+        const size_t writtenSize = (buffer_size - toKeepSize) - inflator.avail_out;
+        buffer_end += writtenSize;
+        out_offset += writtenSize;
 
         // same for raw_begin
         raw_begin += (raw_end - raw_begin) - inflator.avail_in;
+
+        // the range ends with the row containing byte range_end - 1, look for its newline in the new data
+        if (unlikely(out_offset >= range_end)) {
+            char *from = buffer_end - (out_offset - std::max<uint64_t>(range_end - 1, out_offset - writtenSize));
+            auto newline = (char *) memchr(from, '\n', buffer_end - from);
+
+            if (newline) {
+                out_offset -= buffer_end - (newline + 1);
+                buffer_end = newline + 1;
+                range_done = true;
+            }
+        }
     }
 };
\ No newline at end of file
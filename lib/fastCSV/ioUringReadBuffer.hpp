@@ -0,0 +1,226 @@
+#pragma once
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "slotRing.hpp"
+
+// keeps queue_depth reads of BUFF_SIZE_TOTAL bytes in flight with io_uring, bypassing the page cache with O_DIRECT
+// each read targets its own registered buffer (slot), which is handed to the parser once complete and then recycled
+template<unsigned queue_depth = 4>
+class IoUringReadBuffer : public SlotRing<IoUringReadBuffer<queue_depth>, queue_depth> {
+    static_assert(queue_depth >= 2, "at least one read must be in flight while a slot is parsed");
+
+    friend class SlotRing<IoUringReadBuffer, queue_depth>;
+
+private:
+    using SlotRing<IoUringReadBuffer, queue_depth>::BUFF_SIZE_TOTAL;
+
+    // O_DIRECT requires buffers, offsets and sizes aligned to the logical block size, a page covers every device
+    static constexpr size_t ALIGNMENT = 4096;
+
+    // every slot reserves BUFF_SIZE_TOTAL bytes before its data, where the unparsed part of the previous slot is copied
+    // the data is followed by 1 byte for the newline appended to an unterminated last row + 64 zeroed bytes for SIMD reads
+    static constexpr size_t SLOT_DATA_OFFSET = BUFF_SIZE_TOTAL;
+    static constexpr size_t SLOT_SIZE = SLOT_DATA_OFFSET + BUFF_SIZE_TOTAL + ALIGNMENT;
+
+    int fd = -1;
+    size_t file_size = 0;
+
+    char *slots = nullptr;
+    size_t slot_offset[queue_depth]{}; // file offset of the chunk read into each slot
+    size_t slot_size[queue_depth]{}; // number of bytes requested for each slot
+    size_t slot_done[queue_depth]{}; // number of bytes read into each slot so far
+
+    size_t next_offset = 0; // offset of the next chunk to be requested
+
+    // io_uring state
+    int ring_fd = -1;
+    bool registered_buffers = false;
+
+    void *sq_ring = nullptr;
+    size_t sq_ring_size = 0;
+    unsigned *sq_tail = nullptr;
+    unsigned *sq_mask = nullptr;
+    unsigned *sq_array = nullptr;
+    io_uring_sqe *sqes = nullptr;
+    size_t sqes_size = 0;
+
+    void *cq_ring = nullptr;
+    size_t cq_ring_size = 0;
+    unsigned *cq_head = nullptr;
+    unsigned *cq_tail = nullptr;
+    unsigned *cq_mask = nullptr;
+    io_uring_cqe *cqes = nullptr;
+
+    [[nodiscard]] char *slotData(unsigned slot) const { return slots + slot * SLOT_SIZE + SLOT_DATA_OFFSET; }
+
+    // a read continuing a short one starts again at the aligned position before the bytes read so far
+    [[nodiscard]] size_t readStart(unsigned slot) const { return slot_done[slot] / ALIGNMENT * ALIGNMENT; }
+
+    // queue a read for the rest of the chunk of this slot
+    void submit(unsigned slot) {
+        const unsigned tail = *sq_tail;
+        const unsigned index = tail & *sq_mask;
+        const size_t start = readStart(slot);
+
+        io_uring_sqe &sqe = sqes[index];
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = registered_buffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        sqe.fd = fd;
+        sqe.off = slot_offset[slot] + start;
+        sqe.addr = (uint64_t) (slotData(slot) + start);
+        // O_DIRECT reads need an aligned offset, address and size, the last chunk is rounded up and the read stops at the end of the file
+        sqe.len = (slot_size[slot] - start + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        sqe.buf_index = slot;
+        sqe.user_data = slot;
+
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+        [[maybe_unused]] const int submitted = (int) syscall(__NR_io_uring_enter, ring_fd, 1, 0, 0, nullptr, 0);
+        assert(submitted == 1);
+    }
+
+    // request the next chunk of the file into this slot, if any is left
+    void request(unsigned slot) {
+        slot_offset[slot] = next_offset;
+        slot_size[slot] = next_offset < file_size ? std::min(BUFF_SIZE_TOTAL, file_size - next_offset) : 0;
+        slot_done[slot] = 0;
+        next_offset += BUFF_SIZE_TOTAL;
+
+        if (slot_size[slot]) submit(slot);
+    }
+
+    // process completions until the chunk of the given slot was fully read
+    void wait(unsigned slot) {
+        while (slot_done[slot] < slot_size[slot]) {
+            unsigned head = *cq_head;
+            if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+                [[maybe_unused]] const int status = (int) syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+                assert(status != -1 || errno == EINTR);
+                continue;
+            }
+
+            for (; head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE); ++head) {
+                const io_uring_cqe &cqe = cqes[head & *cq_mask];
+                const auto completed = (unsigned) cqe.user_data;
+
+                if (unlikely(cqe.res < 0)) {
+                    if (cqe.res != -EINTR && cqe.res != -EAGAIN) {
+                        fprintf(stderr, "IoUringReadBuffer: read failed: %s\n", strerror(-cqe.res));
+                        abort();
+                    }
+                    submit(completed);
+                    continue;
+                }
+
+                // a read adding no bytes is at the end of the file, which was truncated: the data of the slot ends here, the next slots are empty
+                const size_t done = readStart(completed) + cqe.res;
+                if (unlikely(done <= slot_done[completed])) {
+                    slot_size[completed] = slot_done[completed];
+                    continue;
+                }
+
+                // short reads are continued with a new request
+                slot_done[completed] = done;
+                if (unlikely(slot_done[completed] < slot_size[completed])) submit(completed);
+            }
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        }
+    }
+
+    // waits until the read of the slot completes, a slot can end up empty if the file was truncated
+    size_t waitForSlot(unsigned slot) {
+        wait(slot);
+        return slot_size[slot];
+    }
+
+    // the slot was consumed, and is reused for the chunk after the ones in flight
+    // (on the first call, the current slot is still in flight with the last chunk of the initial batch)
+    void releaseSlot(unsigned slot) {
+        if (slot_offset[slot] + queue_depth * BUFF_SIZE_TOTAL == next_offset) request(slot);
+    }
+
+public:
+    // open file, set up the ring and start the first reads when object is created
+    explicit IoUringReadBuffer(const char *path) {
+        fd = open(path, O_RDONLY | O_DIRECT);
+        // not every filesystem supports O_DIRECT (e.g. tmpfs), the reads are then served from the page cache
+        if (fd == -1 && errno == EINVAL) fd = open(path, O_RDONLY);
+        assert(fd != -1);
+
+        struct stat file_stat{};
+        [[maybe_unused]] const int stat_result = fstat(fd, &file_stat);
+        assert(stat_result == 0);
+        file_size = file_stat.st_size;
+
+        // page aligned slots
+        slots = (char *) mmap(nullptr, queue_depth * SLOT_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        assert(slots != MAP_FAILED);
+
+        // set up the submission and completion rings
+        io_uring_params params{};
+        ring_fd = (int) syscall(__NR_io_uring_setup, queue_depth, &params);
+        assert(ring_fd != -1);
+
+        sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        assert(sq_ring != MAP_FAILED);
+        sq_tail = (unsigned *) ((char *) sq_ring + params.sq_off.tail);
+        sq_mask = (unsigned *) ((char *) sq_ring + params.sq_off.ring_mask);
+        sq_array = (unsigned *) ((char *) sq_ring + params.sq_off.array);
+
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = (io_uring_sqe *) mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        assert(sqes != MAP_FAILED);
+
+        cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        assert(cq_ring != MAP_FAILED);
+        cq_head = (unsigned *) ((char *) cq_ring + params.cq_off.head);
+        cq_tail = (unsigned *) ((char *) cq_ring + params.cq_off.tail);
+        cq_mask = (unsigned *) ((char *) cq_ring + params.cq_off.ring_mask);
+        cqes = (io_uring_cqe *) ((char *) cq_ring + params.cq_off.cqes);
+
+        // registering the slots saves mapping the pages on every read
+        // this can fail if the locked memory limit is too low, plain reads are used then
+        iovec iovecs[queue_depth];
+        for (unsigned slot = 0; slot < queue_depth; ++slot) iovecs[slot] = {slotData(slot), BUFF_SIZE_TOTAL};
+        registered_buffers = syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, iovecs, queue_depth) == 0;
+
+        for (unsigned slot = 0; slot < queue_depth; ++slot) request(slot);
+        this->start();
+    }
+
+    // wait for reads in flight, then release everything when this object is deleted
+    ~IoUringReadBuffer() {
+        for (unsigned slot = 0; slot < queue_depth; ++slot) wait(slot);
+
+        [[maybe_unused]] int result = munmap(cq_ring, cq_ring_size);
+        assert(result == 0);
+        result = munmap(sqes, sqes_size);
+        assert(result == 0);
+        result = munmap(sq_ring, sq_ring_size);
+        assert(result == 0);
+        result = close(ring_fd);
+        assert(result == 0);
+
+        result = munmap(slots, queue_depth * SLOT_SIZE);
+        assert(result == 0);
+        result = close(fd);
+        assert(result == 0);
+    }
+};
\ No newline at end of file
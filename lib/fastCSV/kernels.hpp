@@ -0,0 +1,259 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+#define FASTCSV_X86
+
+#endif
+
+// the SIMD part of the row parser, compiled for several instruction sets into the same binary with GCC target attributes
+// FastCSV instantiates its parser once per kernel, and picks one when it is constructed, based on simd_level
+
+// target attributes of the functions that use each kernel (cpuid is checked for all these features before they are used)
+#define FASTCSV_TARGET_SSE2 __attribute__((target("sse2")))
+#define FASTCSV_TARGET_AVX2 __attribute__((target("avx2,bmi,bmi2,popcnt,pclmul")))
+#define FASTCSV_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx2,bmi,bmi2,popcnt,pclmul")))
+
+enum class SimdLevel { SCALAR, SSE2, AVX2, AVX512 };
+
+// best kernel supported by this CPU
+inline SimdLevel detectSimdLevel() {
+#ifdef FASTCSV_X86
+    __builtin_cpu_init();
+
+    const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2") &&
+                      __builtin_cpu_supports("popcnt") && __builtin_cpu_supports("pclmul");
+
+    if (avx2 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return SimdLevel::AVX512;
+    if (avx2) return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE2;
+#endif
+    return SimdLevel::SCALAR;
+}
+
+// kernel used by FastCSV objects created from now on, can be lowered (e.g. to compare kernels), but not raised above the detected level
+inline SimdLevel simd_level = detectSimdLevel();
+
+// bitmaps of the 64 bytes at a position, bit i is set if byte i is that character of the Dialect
+struct BlockMasks {
+    uint64_t newlines;
+    uint64_t delimiters;
+    uint64_t quotes;
+    uint64_t escapes; // only set if the Dialect has a separate escape character
+};
+
+// bit i of the result is set if byte i is escaped: it comes after an odd number of escape characters (simdjson's escape scanner)
+// escaped carries the state between blocks: bit 0 is set if the first byte of the next block is escaped
+static inline uint64_t escapedBits(uint64_t escapes, uint64_t &escaped) {
+    constexpr uint64_t ODD_BITS = 0xaaaaaaaaaaaaaaaaULL;
+
+    // an escaped escape character does not escape the byte after it
+    const uint64_t potential_escapes = escapes & ~escaped;
+
+    // subtracting the start of every run of escape characters from the bits after the run sets the bit after the run
+    // if the run has an odd length, the ODD_BITS give the parity of the start of each run
+    const uint64_t escape_and_terminal = (((potential_escapes << 1U) | ODD_BITS) - potential_escapes) ^ ODD_BITS;
+    const uint64_t result = escape_and_terminal ^ (escapes | escaped);
+
+    escaped = (escape_and_terminal & escapes) >> 63U;
+    return result;
+}
+
+// stores base + i for every bit i set in bits, returns their number
+static inline int bitPositions(uint32_t *out, uint64_t bits, uint32_t base) {
+    const int count = __builtin_popcountll(bits);
+
+    for (int i = 0; i < count; ++i) {
+        out[i] = base + __builtin_ctzll(bits);
+        bits &= bits - 1ULL; // remove trailing 1 bit
+    }
+    return count;
+}
+
+// 8 bytes at a time in general purpose registers, for CPUs without any of the other kernels
+struct ScalarKernel {
+    // 1 bit per byte of word that is equal to c
+    static inline uint64_t wordMask(uint64_t word, char c) {
+        constexpr uint64_t LOW_7_BITS = 0x7f7f7f7f7f7f7f7fULL;
+
+        // 0x80 in every byte that is zero after the XOR, without carries between bytes
+        const uint64_t zeroes = word ^ (0x0101010101010101ULL * (uint8_t) c);
+        const uint64_t high_bits = ~(((zeroes & LOW_7_BITS) + LOW_7_BITS) | zeroes | LOW_7_BITS);
+
+        // gather the 8 flags (moved to the lowest bit of their byte) into the top byte
+        return ((high_bits >> 7U) * 0x0102040810204080ULL) >> 56U;
+    }
+
+    template<class Dialect>
+    static inline BlockMasks masks(const char *ptr) {
+        BlockMasks masks{};
+        for (unsigned i = 0; i < 8; ++i) {
+            uint64_t word;
+            memcpy(&word, ptr + 8 * i, 8);
+
+            masks.newlines |= wordMask(word, '\n') << (8 * i);
+            masks.delimiters |= wordMask(word, Dialect::DELIMITER) << (8 * i);
+            masks.quotes |= wordMask(word, Dialect::QUOTE) << (8 * i);
+            if constexpr (Dialect::SEPARATE_ESCAPE) masks.escapes |= wordMask(word, Dialect::ESCAPE) << (8 * i);
+        }
+        return masks;
+    }
+
+    // bit i of the result is the XOR of bits 0 to i of the input
+    static inline uint64_t prefixXor(uint64_t bits) {
+        for (unsigned shift = 1; shift < 64; shift <<= 1U) bits ^= bits << shift;
+        return bits;
+    }
+
+    static inline int positions(uint32_t *out, uint64_t bits, uint32_t base) {
+        return bitPositions(out, bits, base);
+    }
+
+    static inline uint64_t charMask(const char *ptr, char c) {
+        uint64_t mask = 0;
+        for (unsigned i = 0; i < 8; ++i) {
+            uint64_t word;
+            memcpy(&word, ptr + 8 * i, 8);
+            mask |= wordMask(word, c) << (8 * i);
+        }
+        return mask;
+    }
+};
+
+#ifdef FASTCSV_X86
+
+// 4 loads of 16 bytes, available on every x86-64 CPU
+struct Sse2Kernel {
+    static inline FASTCSV_TARGET_SSE2 uint64_t maskForChar(const __m128i *blocks, char toFind) {
+        const __m128i mask = _mm_set1_epi8(toFind);
+
+        uint64_t result = 0;
+        for (unsigned i = 0; i < 4; ++i)
+            result |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(blocks[i], mask)) << (16 * i);
+        return result;
+    }
+
+    template<class Dialect>
+    static inline FASTCSV_TARGET_SSE2 BlockMasks masks(const char *ptr) {
+        __m128i blocks[4];
+        for (unsigned i = 0; i < 4; ++i) blocks[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + 16 * i));
+
+        return BlockMasks{maskForChar(blocks, '\n'), maskForChar(blocks, Dialect::DELIMITER), maskForChar(blocks, Dialect::QUOTE),
+                          Dialect::SEPARATE_ESCAPE ? maskForChar(blocks, Dialect::ESCAPE) : 0};
+    }
+
+    static inline FASTCSV_TARGET_SSE2 uint64_t prefixXor(uint64_t bits) {
+        return ScalarKernel::prefixXor(bits);
+    }
+
+    static inline FASTCSV_TARGET_SSE2 int positions(uint32_t *out, uint64_t bits, uint32_t base) {
+        return bitPositions(out, bits, base);
+    }
+
+    static inline FASTCSV_TARGET_SSE2 uint64_t charMask(const char *ptr, char c) {
+        __m128i blocks[4];
+        for (unsigned i = 0; i < 4; ++i) blocks[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + 16 * i));
+        return maskForChar(blocks, c);
+    }
+};
+
+// 2 loads of 32 bytes, and carry-less multiplication for the prefix XOR (Haswell and later)
+struct Avx2Kernel {
+    static inline FASTCSV_TARGET_AVX2 uint64_t maskForChar(__m256i reg_lo, __m256i reg_hi, char toFind) {
+        // compare
+        const __m256i mask = _mm256_set1_epi8(toFind);
+        uint64_t cmp_lo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(reg_lo, mask)));
+        uint64_t cmp_hi = _mm256_movemask_epi8(_mm256_cmpeq_epi8(reg_hi, mask));
+
+        return cmp_lo | (cmp_hi << 32ULL);
+    }
+
+    template<class Dialect>
+    static inline FASTCSV_TARGET_AVX2 BlockMasks masks(const char *ptr) {
+        // load
+        __m256i reg_lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr));
+        __m256i reg_hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr + 32));
+
+        return BlockMasks{maskForChar(reg_lo, reg_hi, '\n'), maskForChar(reg_lo, reg_hi, Dialect::DELIMITER), maskForChar(reg_lo, reg_hi, Dialect::QUOTE),
+                          Dialect::SEPARATE_ESCAPE ? maskForChar(reg_lo, reg_hi, Dialect::ESCAPE) : 0};
+    }
+
+    static inline FASTCSV_TARGET_AVX2 uint64_t prefixXor(uint64_t bits) {
+        return _mm_cvtsi128_si64(_mm_clmulepi64_si128(_mm_set_epi64x(0, (int64_t) bits), _mm_set1_epi8(-1), 0));
+    }
+
+    static inline FASTCSV_TARGET_AVX2 int positions(uint32_t *out, uint64_t bits, uint32_t base) {
+        return bitPositions(out, bits, base);
+    }
+
+    static inline FASTCSV_TARGET_AVX2 uint64_t charMask(const char *ptr, char c) {
+        return maskForChar(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr)), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr + 32)), c);
+    }
+};
+
+// a single 64 byte load, compared straight into mask registers (Skylake-X, Ice Lake and later)
+struct Avx512Kernel {
+    static constexpr int COMPRESS_MIN_BITS = 8;
+
+    template<class Dialect>
+    static inline FASTCSV_TARGET_AVX512 BlockMasks masks(const char *ptr) {
+        const __m512i reg = _mm512_loadu_si512(ptr);
+
+        return BlockMasks{_mm512_cmpeq_epi8_mask(reg, _mm512_set1_epi8('\n')), _mm512_cmpeq_epi8_mask(reg, _mm512_set1_epi8(Dialect::DELIMITER)),
+                          _mm512_cmpeq_epi8_mask(reg, _mm512_set1_epi8(Dialect::QUOTE)),
+                          Dialect::SEPARATE_ESCAPE ? _mm512_cmpeq_epi8_mask(reg, _mm512_set1_epi8(Dialect::ESCAPE)) : 0};
+    }
+
+    static inline FASTCSV_TARGET_AVX512 uint64_t prefixXor(uint64_t bits) {
+        return Avx2Kernel::prefixXor(bits);
+    }
+
+    // 16 bits at a time: VPCOMPRESSD packs the offsets of the set bits, which are stored as a full vector
+    // instead of one TZCNT per bit, which matters for wide rows with many columns per block
+    static inline FASTCSV_TARGET_AVX512 int positions(uint32_t *out, uint64_t bits, uint32_t base) {
+        // a few TZCNTs are cheaper for the usual narrow rows
+        if (__builtin_popcountll(bits) <= COMPRESS_MIN_BITS) return bitPositions(out, bits, base);
+
+        __m512i offsets = _mm512_add_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32((int) base));
+
+        int count = 0;
+        for (; bits; bits >>= 16U) {
+            _mm512_storeu_si512(out + count, _mm512_maskz_compress_epi32((__mmask16) bits, offsets));
+            count += __builtin_popcount((uint16_t) bits);
+
+            offsets = _mm512_add_epi32(offsets, _mm512_set1_epi32(16));
+        }
+        return count;
+    }
+
+    static inline FASTCSV_TARGET_AVX512 uint64_t charMask(const char *ptr, char c) {
+        return _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(ptr), _mm512_set1_epi8(c));
+    }
+};
+
+#endif
+
+// first position of needle (not empty) in [begin, end), or nullptr, reading up to 63 bytes past end
+// the candidates are the positions where both the first and the last byte of the needle are found, 64 at a time (Mula's SIMD strstr)
+// and only those are compared in full
+template<class Kernel>
+static inline const char *findNeedle(const char *begin, const char *end, std::string_view needle) {
+    const size_t size = needle.size();
+
+    for (const char *ptr = begin; ptr + size <= end; ptr += 64) {
+        uint64_t candidates = Kernel::charMask(ptr, needle.front()) & Kernel::charMask(ptr + size - 1, needle.back());
+
+        for (; candidates; candidates &= candidates - 1ULL) {
+            const char *const match = ptr + __builtin_ctzll(candidates);
+            if (match + size > end) return nullptr;
+            if (memcmp(match + 1, needle.data() + 1, size - 1) == 0) return match;
+        }
+    }
+    return nullptr;
+}
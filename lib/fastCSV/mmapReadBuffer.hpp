@@ -0,0 +1,136 @@
+#pragma once
+
+#include <string_view>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+#ifndef unlikely
+#define unlikely(x) __builtin_expect(!!(x), 0)
+#endif
+
+// maps the whole file into memory, so rows are parsed directly from the page cache without being copied
+// all string_views returned by FastCSV stay valid for the lifetime of the reader
+class MmapReadBuffer {
+private:
+    // the file is read ahead by the kernel in chunks of this size, instead of all at once
+    static constexpr size_t WILLNEED_SIZE = 64 * (1U << 20U);
+
+    int fd = -1;
+
+    char *mapping = nullptr;
+    size_t mapping_size = 0;
+
+    // maps the whole file, buffer_begin and buffer_end are set around it
+    void map(const char *path) {
+        fd = open(path, O_RDONLY);
+        assert(fd != -1);
+
+        struct stat file_stat{};
+        [[maybe_unused]] const int stat_result = fstat(fd, &file_stat);
+        assert(stat_result == 0);
+        const size_t file_size = file_stat.st_size;
+
+        // reserve zeroed memory for the file + 1 byte for a terminating newline + 64 bytes for SIMD reads past buffer_end
+        // then map the file over the beginning of it: the padding never reaches past the end of the reserved memory
+        const size_t page_size = sysconf(_SC_PAGESIZE);
+        mapping_size = (file_size + 1 + 64 + page_size - 1) / page_size * page_size;
+
+        mapping = (char *) mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        assert(mapping != MAP_FAILED);
+
+        if (file_size) {
+            [[maybe_unused]] const void *const file_mapping = mmap(mapping, file_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+            assert(file_mapping == mapping);
+        }
+
+        buffer_begin = mapping;
+        buffer_end = mapping + file_size;
+
+        // terminate the last row if the file does not end with a newline
+        // the last page becomes a private copy, the file itself is never written
+        if (file_size && unlikely(buffer_end[-1] != '\n')) {
+            char *page = mapping + file_size / page_size * page_size;
+            [[maybe_unused]] const int protect_result = mprotect(page, mapping + mapping_size - page, PROT_READ | PROT_WRITE);
+            assert(protect_result == 0);
+            *buffer_end++ = '\n';
+        }
+    }
+
+public:
+    char *buffer_begin = nullptr;
+    char *buffer_end = nullptr;
+
+    // the whole file is available from the start
+    bool eof = true;
+
+    // open and map file when object is created
+    explicit MmapReadBuffer(const char *path) {
+        map(path);
+
+        if (buffer_end != buffer_begin) {
+            madvise(mapping, buffer_end - buffer_begin, MADV_SEQUENTIAL);
+            madvise(mapping, std::min<size_t>(buffer_end - buffer_begin, WILLNEED_SIZE), MADV_WILLNEED);
+        }
+    }
+
+    // only read the rows starting in the byte range [begin, end) of the file
+    // a row crossing begin belongs to the previous range, and a row crossing end to this one
+    // so consecutive ranges split the file without gaps or overlaps
+    MmapReadBuffer(const char *path, size_t begin, size_t end) {
+        map(path);
+
+        char *const data_end = buffer_end;
+        assert(begin <= end && mapping + end <= data_end);
+
+        // the newline ending the row which contains the byte before the range position
+        auto snap = [&](size_t position) {
+            if (position == 0) return mapping;
+
+            auto newline = (char *) memchr(mapping + position - 1, '\n', data_end - (mapping + position - 1));
+            return newline ? newline + 1 : data_end;
+        };
+        buffer_begin = snap(begin);
+        buffer_end = snap(end);
+
+        if (buffer_end != buffer_begin) {
+            const size_t page_size = sysconf(_SC_PAGESIZE);
+            char *page = mapping + (buffer_begin - mapping) / page_size * page_size;
+
+            madvise(page, buffer_end - page, MADV_SEQUENTIAL);
+            madvise(page, std::min<size_t>(buffer_end - page, WILLNEED_SIZE), MADV_WILLNEED);
+        }
+    }
+
+    // size of the whole file, ranges are given as offsets into it
+    static size_t dataSize(const char *path) {
+        struct stat file_stat{};
+        [[maybe_unused]] const int stat_result = stat(path, &file_stat);
+        assert(stat_result == 0);
+        return file_stat.st_size;
+    }
+
+    // restarts at the given offset of the file, up to the same end (the end of the range, if there is one)
+    void seek(uint64_t offset) {
+        assert(mapping + offset <= buffer_end && "offset is past the end of the data");
+        buffer_begin = mapping + offset;
+    }
+
+    // unmap and close the file when this object is deleted
+    ~MmapReadBuffer() {
+        [[maybe_unused]] const int unmap_result = munmap(mapping, mapping_size);
+        assert(unmap_result == 0);
+        [[maybe_unused]] const int close_result = close(fd);
+        assert(close_result == 0);
+    }
+
+    // the whole file is already mapped, toKeep data always stays in place
+    void readMore(char *, size_t) {
+        eof = true;
+    }
+};
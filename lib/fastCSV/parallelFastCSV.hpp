@@ -0,0 +1,74 @@
+#pragma once
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "fastCSV.hpp"
+#include "mmapReadBuffer.hpp"
+
+// splits the file into one byte range per thread, and parses every range with its own FastCSV object
+// ReadBuffer has to support ranges: a (path, begin, end) constructor and a static dataSize(path), like MmapReadBuffer
+// (or GzipReadBuffer, which then uses a GzipIndex)
+// ranges are split at newlines, so rows must not contain newlines, even quoted or escaped ones
+
+// calls function(row) for every row of the file, from several threads at once
+// rows of a range are visited in order, but ranges are processed concurrently
+template<int max_columns, class ReadBuffer = MmapReadBuffer, class CSVDialect = Dialect<>, class Function>
+void parallelForEach(const char *path, Function &&function, bool skip_header = true,
+                     unsigned threads = std::thread::hardware_concurrency()) {
+    using CSV = FastCSV<max_columns, ReadBuffer, CSVDialect>;
+
+    if (threads == 0) threads = 1;
+    const size_t size = ReadBuffer::dataSize(path);
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i] {
+            const size_t begin = size * i / threads, end = size * (i + 1) / threads;
+            auto csv = std::make_unique<CSV>(path, begin, end);
+
+            // the header is in the first non-empty range
+            if (skip_header && begin == 0 && end != 0) csv->nextRow();
+
+            for (const auto &row : *csv) function(row);
+        });
+    }
+
+    for (auto &worker : workers) worker.join();
+}
+
+// every thread calls function(accumulator, row) on its own copy of init, for the rows of its range
+// the accumulators are then combined in file order with merge(accumulator, other_accumulator), into the first one, which is returned
+template<int max_columns, class ReadBuffer = MmapReadBuffer, class CSVDialect = Dialect<>, class Accumulator, class Function, class Merge>
+Accumulator parallelReduce(const char *path, const Accumulator &init, Function &&function, Merge &&merge, bool skip_header = true,
+                           unsigned threads = std::thread::hardware_concurrency()) {
+    using CSV = FastCSV<max_columns, ReadBuffer, CSVDialect>;
+
+    if (threads == 0) threads = 1;
+    const size_t size = ReadBuffer::dataSize(path);
+
+    std::vector<Accumulator> accumulators(threads, init);
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i] {
+            const size_t begin = size * i / threads, end = size * (i + 1) / threads;
+            auto csv = std::make_unique<CSV>(path, begin, end);
+
+            // the header is in the first non-empty range
+            if (skip_header && begin == 0 && end != 0) csv->nextRow();
+
+            Accumulator &accumulator = accumulators[i];
+            for (const auto &row : *csv) function(accumulator, row);
+        });
+    }
+
+    for (auto &worker : workers) worker.join();
+
+    for (unsigned i = 1; i < threads; ++i) merge(accumulators[0], std::move(accumulators[i]));
+    return std::move(accumulators[0]);
+}
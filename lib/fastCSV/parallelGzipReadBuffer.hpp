@@ -0,0 +1,359 @@
+#pragma once
+
+#include <string_view>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cassert>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "../zlib/zlib.h"
+
+#ifndef unlikely
+#define unlikely(x) __builtin_expect(!!(x), 0)
+#endif
+
+// inflates files made of many gzip members (concatenated .gz files, chunks compressed separately by gzip or pigz and appended, bgzip / BGZF) on several threads
+// pigz --independent still writes a single member, it only resets the dictionary between blocks
+// the compressed file is split in TASK_SIZE ranges, and worker threads inflate the members starting in each range
+// member starts are found by scanning for gzip headers, so a task can begin at a false match inside compressed data:
+// tasks are used in order only if they start exactly where the previous member ended, otherwise that range is inflated serially
+// a file with a single member is therefore inflated serially, like GzipReadBuffer would
+class ParallelGzipReadBuffer {
+private:
+    static constexpr size_t BUFF_SIZE_MB = 1;
+    static constexpr size_t BUFF_SIZE_TOTAL = BUFF_SIZE_MB * (1U << 20U);
+
+    // compressed bytes per task, and the maximum inflated size of a task before it is left to the serial path
+    static constexpr size_t TASK_SIZE = 1U << 20U;
+    static constexpr size_t MAX_TASK_OUTPUT = 64 * (1U << 20U);
+
+    // zlib takes at most UINT_MAX input bytes per call
+    static constexpr size_t MAX_AVAIL_IN = 1U << 30U;
+
+    int fd = -1;
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+
+    // + 1 for the newline appended to an unterminated last row, + 64 zeroed bytes for SIMD reads past buffer_end
+    // starts at BUFF_SIZE_TOTAL bytes, and doubles whenever a row fills more than half of it
+    size_t buffer_size = BUFF_SIZE_TOTAL;
+    std::unique_ptr<char[]> storage{new char[BUFF_SIZE_TOTAL + 1 + 64]{}};
+    char *buffer = storage.get();
+
+    // tasks results, indexed by task % tasks.size()
+    struct Task {
+        enum State { FAILED, DONE, EMPTY, ABANDONED } state = FAILED;
+        size_t index = SIZE_MAX; // set once the result is published
+        size_t start = 0, end = 0; // compressed range of the inflated members
+        std::vector<char> output;
+    };
+    std::vector<Task> tasks;
+    size_t task_count = 0;
+    size_t next_task = 0; // next task to be picked by a worker
+    size_t current_task = 0; // task containing position, results of previous tasks are discarded
+
+    std::mutex mutex;
+    std::condition_variable task_published;
+    std::condition_variable task_consumed;
+    bool stopping = false;
+
+    std::vector<std::thread> workers;
+
+    // parser side state
+    size_t position = 0; // compressed offset of the next member to be inflated
+    std::vector<char> output; // output of the task being copied to the buffer
+    const char *output_pos = nullptr;
+    const char *output_end = nullptr;
+
+    bool serial = false; // inflating members on this thread until serial_limit
+    bool serial_in_member = false;
+    size_t serial_limit = 0;
+    z_stream serial_inflator{};
+
+    // checks that a gzip header starts at this offset
+    // for BGZF members, the block size from the extra field must also lead to the next member or to the end of the file
+    [[nodiscard]] bool isMemberStart(size_t offset) const {
+        if (size - offset < 18) return false;
+
+        const uint8_t *header = data + offset;
+        if (header[0] != 0x1f || header[1] != 0x8b || header[2] != 8 || (header[3] & 0xe0U)) return false;
+
+        // FEXTRA with a BC subfield
+        if ((header[3] & 4U) && header[10] == 6 && header[12] == 'B' && header[13] == 'C' && header[14] == 2) {
+            const size_t next = offset + (header[16] | (header[17] << 8U)) + 1;
+            return next == size || (next + 3 <= size && data[next] == 0x1f && data[next + 1] == 0x8b && data[next + 2] == 8);
+        }
+
+        return true;
+    }
+
+    enum class MemberResult { OK, FAILED, TOO_LARGE };
+
+    // inflates the member starting at offset, appending to output (of which used bytes are valid)
+    // on success, offset is moved to the end of the member
+    MemberResult inflateMember(z_stream &inflator, size_t &offset, std::vector<char> &out, size_t &used) const {
+        [[maybe_unused]] const int reset_status = inflateReset(&inflator);
+        assert(reset_status == Z_OK);
+        inflator.next_in = (uint8_t *) data + offset;
+
+        while (true) {
+            if (out.size() - used < BUFF_SIZE_TOTAL / 16) {
+                if (used >= MAX_TASK_OUTPUT) return MemberResult::TOO_LARGE;
+                out.resize(std::max(out.size() * 2, BUFF_SIZE_TOTAL));
+            }
+
+            inflator.avail_in = std::min(size - (inflator.next_in - data), MAX_AVAIL_IN);
+            inflator.avail_out = std::min(out.size() - used, MAX_AVAIL_IN);
+            inflator.next_out = (uint8_t *) out.data() + used;
+
+            int status = inflate(&inflator, Z_NO_FLUSH);
+            used = (char *) inflator.next_out - out.data();
+
+            if (status == Z_STREAM_END) {
+                offset = inflator.next_in - data;
+                return MemberResult::OK;
+            }
+            // an error, or a member truncated by the end of the file
+            if (status != Z_OK || inflator.next_in == data + size) return MemberResult::FAILED;
+        }
+    }
+
+    // inflates the members starting in the compressed range of the task
+    void runTask(size_t index, z_stream &inflator, Task &task) const {
+        const size_t range_begin = index * TASK_SIZE;
+        const size_t range_end = std::min(range_begin + TASK_SIZE, size);
+
+        size_t used = 0;
+        for (size_t candidate = range_begin; candidate < range_end; ++candidate) {
+            auto found = (const uint8_t *) memchr(data + candidate, 0x1f, range_end - candidate);
+            if (!found) break;
+
+            candidate = found - data;
+            if (!isMemberStart(candidate)) continue;
+
+            size_t offset = candidate;
+            used = 0;
+
+            MemberResult result = inflateMember(inflator, offset, task.output, used);
+            if (result == MemberResult::FAILED) continue; // false match, try the next one
+            if (result == MemberResult::TOO_LARGE) {
+                task.state = Task::ABANDONED;
+                return;
+            }
+
+            // following members, until one starts after the range
+            // a member that fails or does not fit is left to the serial path, which starts where this task ends
+            while (offset < range_end) {
+                size_t next_offset = offset, next_used = used;
+                if (inflateMember(inflator, next_offset, task.output, next_used) != MemberResult::OK) break;
+
+                offset = next_offset;
+                used = next_used;
+            }
+
+            task.state = Task::DONE;
+            task.start = candidate;
+            task.end = offset;
+            task.output.resize(used);
+            return;
+        }
+
+        task.state = Task::EMPTY;
+    }
+
+    // picks tasks in order, at most tasks.size() ahead of the parser
+    void workerLoop() {
+        z_stream inflator{};
+        // + 16 for gzip header & footer parsing
+        [[maybe_unused]] int status = inflateInit2(&inflator, 15 + 16);
+        assert(status == Z_OK);
+
+        while (true) {
+            size_t index;
+            {
+                std::unique_lock lock{mutex};
+                task_consumed.wait(lock, [&] {
+                    return stopping || next_task >= task_count || next_task < current_task + tasks.size();
+                });
+                if (stopping || next_task >= task_count) break;
+
+                next_task = std::max(next_task, current_task);
+                index = next_task++;
+            }
+
+            Task task;
+            runTask(index, inflator, task);
+
+            {
+                std::lock_guard lock{mutex};
+                // the parser may have skipped this task while it was running
+                if (index >= current_task) {
+                    task.index = index;
+                    tasks[index % tasks.size()] = std::move(task);
+                }
+            }
+            task_published.notify_all();
+        }
+
+        status = inflateEnd(&inflator);
+        assert(status == Z_OK);
+    }
+
+    // moves on to the task containing position, and either copies its output or inflates its range serially
+    void nextTask() {
+        const size_t index = position / TASK_SIZE;
+        Task &task = tasks[index % tasks.size()];
+
+        {
+            std::unique_lock lock{mutex};
+            current_task = index;
+            task_consumed.notify_all();
+            task_published.wait(lock, [&] { return task.index == index; });
+        }
+
+        if (task.state == Task::DONE && task.start == position) {
+            output = std::move(task.output);
+            output_pos = output.data();
+            output_end = output.data() + output.size();
+            position = task.end;
+        } else {
+            serial = true;
+            serial_limit = std::min((index + 1) * TASK_SIZE, size);
+        }
+    }
+
+    // inflates the next part of the current member into the buffer, on this thread
+    void inflateSerial() {
+        if (!serial_in_member) {
+            [[maybe_unused]] const int status = inflateReset(&serial_inflator);
+            assert(status == Z_OK);
+            serial_inflator.next_in = (uint8_t *) data + position;
+            serial_in_member = true;
+        }
+
+        serial_inflator.avail_in = std::min(size - (serial_inflator.next_in - data), MAX_AVAIL_IN);
+        serial_inflator.avail_out = buffer + buffer_size - buffer_end;
+        serial_inflator.next_out = (uint8_t *) buffer_end;
+
+        int status = inflate(&serial_inflator, Z_SYNC_FLUSH);
+        assert(status == Z_OK || status == Z_STREAM_END);
+        buffer_end = (char *) serial_inflator.next_out;
+
+        if (status == Z_STREAM_END) {
+            serial_in_member = false;
+            position = serial_inflator.next_in - data;
+            if (position >= serial_limit || position == size) serial = false;
+        }
+    }
+
+    // replaces the buffer with one twice as large, starting with the toKeep data
+    void grow(char *&toKeep, size_t toKeepSize) {
+        std::unique_ptr<char[]> grown{new char[2 * buffer_size + 1 + 64]};
+        memcpy(grown.get(), toKeep, toKeepSize);
+
+        storage = std::move(grown);
+        buffer = buffer_begin = toKeep = storage.get();
+        buffer_size *= 2;
+    }
+
+public:
+    char *buffer_begin = buffer;
+    char *buffer_end = buffer;
+
+    bool eof = false;
+
+    // open and map file, and start the worker threads when object is created
+    explicit ParallelGzipReadBuffer(const char *path) {
+        fd = open(path, O_RDONLY);
+        assert(fd != -1);
+
+        struct stat file_stat{};
+        [[maybe_unused]] const int stat_result = fstat(fd, &file_stat);
+        assert(stat_result == 0);
+        size = file_stat.st_size;
+
+        if (size) {
+            data = (const uint8_t *) mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            assert(data != MAP_FAILED);
+        }
+
+        // + 16 for gzip header & footer parsing
+        [[maybe_unused]] const int status = inflateInit2(&serial_inflator, 15 + 16);
+        assert(status == Z_OK);
+
+        const unsigned threads = std::max(std::thread::hardware_concurrency(), 1U);
+        task_count = (size + TASK_SIZE - 1) / TASK_SIZE;
+        tasks.resize(2 * threads);
+
+        for (unsigned i = 0; i < threads; ++i) workers.emplace_back(&ParallelGzipReadBuffer::workerLoop, this);
+
+        readMore(buffer, 0);
+    }
+
+    // stop the worker threads, unmap and close the file when this object is deleted
+    ~ParallelGzipReadBuffer() {
+        {
+            std::lock_guard lock{mutex};
+            stopping = true;
+        }
+        task_consumed.notify_all();
+        for (auto &worker : workers) worker.join();
+
+        [[maybe_unused]] int result = inflateEnd(&serial_inflator);
+        assert(result == Z_OK);
+        if (size) {
+            result = munmap((void *) data, size);
+            assert(result == 0);
+        }
+        result = close(fd);
+        assert(result == 0);
+    }
+
+    // copy inflated data in file order to buffer, after toKeep data
+    // sets eof = true when there are no more bytes to be read
+    // after eof, toKeep data stays where it was, ends with a newline and is followed by 64 zero bytes
+    void readMore(char *toKeep, size_t toKeepSize) {
+        if (unlikely(output_pos == output_end && !serial && position == size)) {
+            eof = true;
+
+            // terminate the last row if the file does not end with a newline
+            if (toKeepSize && buffer_end[-1] != '\n') *buffer_end++ = '\n';
+
+            memset(buffer_end, 0, 64); // clear last 64 bytes
+            return;
+        }
+
+        // a row filling more than half of the buffer is moved to one twice as large, so that every call adds at least as many bytes
+        // as are kept, and a long row is re-parsed O(log(size)) times, not O(size / BUFF_SIZE_TOTAL) times
+        if (unlikely(toKeepSize > buffer_size / 2)) grow(toKeep, toKeepSize);
+
+        // copy toKeep data exactly before the data we'll add below
+        memmove(buffer, toKeep, toKeepSize);
+        buffer_end = buffer + toKeepSize;
+
+        while (buffer_end != buffer + buffer_size) {
+            if (output_pos != output_end) {
+                const size_t copySize = std::min<size_t>(output_end - output_pos, buffer + buffer_size - buffer_end);
+                memcpy(buffer_end, output_pos, copySize);
+                buffer_end += copySize;
+                output_pos += copySize;
+            } else if (serial) {
+                inflateSerial();
+            } else if (position != size) {
+                nextTask();
+            } else {
+                break;
+            }
+        }
+    }
+};
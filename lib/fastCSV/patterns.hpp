@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#ifndef unlikely
+#define unlikely(x) __builtin_expect(!!(x), 0)
+#endif
+
+// the matchers of filters with many values (hundreds to thousands of keys), which check them all in one pass over a column
+
+// a set of keys for exact matches, in an open addressing hash table
+// most values are not in the set, so their length and first byte are checked against those of the keys before hashing
+class KeySet {
+public:
+    KeySet() = default;
+
+    explicit KeySet(const std::vector<std::string_view> &keys) {
+        size_t slots = 16;
+        while (slots < 2 * keys.size()) slots *= 2;
+        table.assign(slots, Entry{});
+        mask = slots - 1;
+
+        for (std::string_view key : keys) {
+            if (key.size() < 64) lengths |= 1ULL << key.size();
+            else long_keys = true;
+            if (!key.empty()) first_bytes[(uint8_t) key[0] >> 6U] |= 1ULL << ((uint8_t) key[0] & 63U);
+
+            if (contains(key)) continue; // duplicate
+            size_t slot = hash(key) & mask;
+            while (table[slot].size != EMPTY) slot = (slot + 1) & mask;
+            table[slot] = Entry{(uint32_t) storage.size(), (uint32_t) key.size()};
+            storage += key;
+        }
+    }
+
+    [[nodiscard]] bool contains(std::string_view value) const {
+        if (value.size() < 64 ? !(lengths >> value.size() & 1U) : !long_keys) return false;
+        if (!value.empty() && !(first_bytes[(uint8_t) value[0] >> 6U] >> ((uint8_t) value[0] & 63U) & 1U)) return false;
+
+        for (size_t slot = hash(value) & mask; table[slot].size != EMPTY; slot = (slot + 1) & mask) {
+            const Entry entry = table[slot];
+            if (entry.size == value.size() && memcmp(storage.data() + entry.offset, value.data(), value.size()) == 0) return true;
+        }
+        return false;
+    }
+
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    struct Entry {
+        uint32_t offset = 0; // of the key in storage
+        uint32_t size = EMPTY;
+    };
+
+    // FNV-1a, 8 bytes at a time
+    static size_t hash(std::string_view value) {
+        uint64_t result = 0xcbf29ce484222325ULL ^ value.size();
+        size_t i = 0;
+        for (; i + 8 <= value.size(); i += 8) {
+            uint64_t word;
+            memcpy(&word, value.data() + i, 8);
+            result = (result ^ word) * 0x100000001b3ULL;
+        }
+        for (; i < value.size(); ++i) result = (result ^ (uint8_t) value[i]) * 0x100000001b3ULL;
+        return result ^ (result >> 32U);
+    }
+
+    std::string storage; // all the keys, one after the other
+    std::vector<Entry> table;
+    size_t mask = 0;
+
+    uint64_t lengths = 0; // bit i is set if a key has i bytes
+    bool long_keys = false; // a key has 64 bytes or more
+    uint64_t first_bytes[4]{}; // bit i of the 256 is set if a key starts with byte i
+};
+
+// finds whether a text contains any of the needles, with an Aho-Corasick automaton turned into a DFA: one table lookup per byte of the text
+// the bytes are mapped to classes first (one per byte found in the needles, and one for all the others), which keeps the table small
+class AhoCorasick {
+public:
+    AhoCorasick() = default;
+
+    explicit AhoCorasick(const std::vector<std::string_view> &needles) {
+        // byte classes, 0 is for the bytes that are in no needle
+        for (std::string_view needle : needles) {
+            assert(!needle.empty() && "needles cannot be empty");
+            for (char c : needle) {
+                if (!byte_class[(uint8_t) c]) byte_class[(uint8_t) c] = classes++;
+            }
+        }
+
+        // trie of the needles, with NONE for missing transitions
+        std::vector<uint32_t> trie(classes, NONE);
+        std::vector<bool> output(1, false);
+        for (std::string_view needle : needles) {
+            uint32_t state = 0;
+            for (char c : needle) {
+                uint32_t &next = trie[state * classes + byte_class[(uint8_t) c]];
+                if (next == NONE) {
+                    next = (uint32_t) output.size();
+                    output.push_back(false);
+                    trie.resize(trie.size() + classes, NONE);
+                }
+                state = trie[state * classes + byte_class[(uint8_t) c]];
+            }
+            output[state] = true;
+        }
+
+        // breadth first, the missing transitions of a state are those of its failure state (the longest suffix of its path that is in the trie)
+        // and a state matches if its failure state does
+        const size_t states = output.size();
+        std::vector<uint32_t> fail(states, 0), queue;
+        queue.reserve(states);
+        for (uint32_t c = 0; c < classes; ++c) {
+            uint32_t &next = trie[c];
+            if (next == NONE) next = 0;
+            else queue.push_back(next);
+        }
+        for (size_t i = 0; i < queue.size(); ++i) {
+            const uint32_t state = queue[i];
+            for (uint32_t c = 0; c < classes; ++c) {
+                uint32_t &next = trie[state * classes + c];
+                const uint32_t fallback = trie[fail[state] * classes + c];
+                if (next == NONE) {
+                    next = fallback;
+                } else {
+                    fail[next] = fallback;
+                    output[next] = output[next] || output[fallback];
+                    queue.push_back(next);
+                }
+            }
+        }
+
+        // the table holds the row of the next state (its index times classes), with MATCH set if it is the end of a needle
+        assert(trie.size() < MATCH && "too many needles");
+        transitions.resize(trie.size());
+        for (size_t i = 0; i < trie.size(); ++i) transitions[i] = trie[i] * classes | (output[trie[i]] ? MATCH : 0);
+    }
+
+    [[nodiscard]] bool search(std::string_view text) const {
+        const uint32_t *const table = transitions.data();
+        uint32_t state = 0;
+
+        for (char c : text) {
+            state = table[state + byte_class[(uint8_t) c]];
+            if (unlikely(state & MATCH)) return true;
+        }
+        return false;
+    }
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    static constexpr uint32_t MATCH = 1U << 31U;
+
+    uint16_t byte_class[256]{};
+    uint32_t classes = 1;
+    std::vector<uint32_t> transitions;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cassert>
+
+#include "slotRing.hpp"
+#include "../zlib/zlib.h"
+
+// reads and inflates the file on a helper thread, which keeps the next SLOTS - 1 blocks of output ready while the current one is parsed
+// decompression and parsing overlap, readMore() only waits if the helper thread falls behind
+class PipelinedGzipReadBuffer : public ThreadSlotRing<PipelinedGzipReadBuffer> {
+    friend class ThreadSlotRing<PipelinedGzipReadBuffer>;
+
+private:
+    static constexpr size_t BUFF_SIZE_RAW = BUFF_SIZE_TOTAL / 16;
+
+    int fd = -1;
+
+    // only used by the helper thread
+    uint8_t raw_buffer[BUFF_SIZE_RAW]{};
+    uint8_t *raw_begin = raw_buffer;
+    uint8_t *raw_end = raw_buffer;
+
+    z_stream inflator{};
+    bool zlib_eos = false;
+
+    // inflate until the slot is full or the file ends, returns the number of bytes written
+    size_t fill(char *data) {
+        size_t size = 0;
+
+        while (size < BUFF_SIZE_TOTAL) {
+            // fetch more raw data if needed
+            if (raw_begin == raw_end) {
+                int readSize = read(fd, raw_buffer, BUFF_SIZE_RAW);
+                assert(readSize != -1);
+
+                // update pointers
+                raw_begin = raw_buffer;
+                raw_end = raw_buffer + readSize;
+
+                if (unlikely(readSize == 0)) break; // end of file
+            }
+
+            // raw data left after the end of a gzip member means this is an appended file
+            if (unlikely(zlib_eos)) {
+                [[maybe_unused]] const int status = inflateReset(&inflator);
+                assert(status == Z_OK);
+                zlib_eos = false;
+            }
+
+            // inflate data
+            inflator.avail_in = raw_end - raw_begin;
+            inflator.next_in = raw_begin;
+
+            inflator.avail_out = BUFF_SIZE_TOTAL - size;
+            inflator.next_out = (uint8_t *) data + size;
+
+            int status = inflate(&inflator, Z_SYNC_FLUSH);
+            assert(status == Z_OK || status == Z_STREAM_END);
+            zlib_eos = status == Z_STREAM_END;
+
+            // the difference between the original available size and the available size after the call is the size of written bytes
+            size += (BUFF_SIZE_TOTAL - size) - inflator.avail_out;
+
+            // same for raw_begin
+            raw_begin += (raw_end - raw_begin) - inflator.avail_in;
+        }
+
+        return size;
+    }
+
+public:
+    // open file and start inflating ahead when object is created
+    explicit PipelinedGzipReadBuffer(const char *path) {
+        fd = open(path, O_RDONLY);
+        assert(fd != -1);
+
+        // + 16 for gzip header & footer parsing
+        [[maybe_unused]] const int status = inflateInit2(&inflator, 15 + 16);
+        assert(status == Z_OK);
+
+        start();
+    }
+
+    // stop the helper thread and close the file when this object is deleted
+    ~PipelinedGzipReadBuffer() {
+        stop();
+
+        [[maybe_unused]] const int close_result = close(fd);
+        assert(close_result == 0);
+        [[maybe_unused]] const int status = inflateEnd(&inflator);
+        assert(status == Z_OK);
+    }
+};
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cassert>
+
+#include "slotRing.hpp"
+
+// reads the file on a helper thread, which keeps the next SLOTS - 1 chunks filled while the current one is parsed
+// readMore() only waits if the helper thread falls behind, and never calls read() itself
+class PrefetchReadBuffer : public ThreadSlotRing<PrefetchReadBuffer> {
+    friend class ThreadSlotRing<PrefetchReadBuffer>;
+
+private:
+    int fd = -1;
+
+    // read until the slot is full, short reads are common on network filesystems
+    size_t fill(char *data) {
+        size_t size = 0;
+        while (size < BUFF_SIZE_TOTAL) {
+            ssize_t readSize = read(fd, data + size, BUFF_SIZE_TOTAL - size);
+            assert(readSize != -1);
+            if (readSize == 0) break;
+            size += readSize;
+        }
+        return size;
+    }
+
+public:
+    // open file and start reading ahead when object is created
+    explicit PrefetchReadBuffer(const char *path) {
+        fd = open(path, O_RDONLY);
+        assert(fd != -1);
+
+        start();
+    }
+
+    // stop the helper thread and close the file when this object is deleted
+    ~PrefetchReadBuffer() {
+        stop();
+
+        [[maybe_unused]] const int close_result = close(fd);
+        assert(close_result == 0);
+    }
+};
\ No newline at end of file
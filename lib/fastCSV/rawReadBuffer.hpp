@@ -6,6 +6,7 @@
 #include <unistd.h>
 #include <cassert>
 #include <cstring>
+#include <memory>
 
 #ifndef unlikely
 #define unlikely(x) __builtin_expect(!!(x), 0)
@@ -19,7 +20,11 @@ public:
     static constexpr size_t BUFF_SIZE_MB = 1;
     static constexpr size_t BUFF_SIZE_TOTAL = BUFF_SIZE_MB * (1U << 20U);
 
-    char buffer[BUFF_SIZE_TOTAL + 64]{};
+    // + 1 for the newline appended to an unterminated last row, + 64 zeroed bytes for SIMD reads past buffer_end
+    // starts at BUFF_SIZE_TOTAL bytes, and doubles whenever a row fills more than half of it
+    size_t buffer_size = BUFF_SIZE_TOTAL;
+    std::unique_ptr<char[]> storage{new char[BUFF_SIZE_TOTAL + 1 + 64]{}};
+    char *buffer = storage.get();
 
 public:
     char *buffer_begin = buffer;
@@ -32,32 +37,63 @@ public:
         fd = open(path, O_RDONLY);
         assert(fd != -1);
 
-        readMore(nullptr, 0);
+        readMore(buffer, 0);
     }
 
     // close the file when this object is deleted
     ~RawReadBuffer() {
-        assert(close(fd) == 0);
+        [[maybe_unused]] const int close_result = close(fd);
+        assert(close_result == 0);
+    }
+
+    // restarts reading at the given offset of the file, the data in the buffer is dropped
+    void seek(uint64_t offset) {
+        [[maybe_unused]] const off_t position = lseek(fd, (off_t) offset, SEEK_SET);
+        assert(position == (off_t) offset);
+
+        eof = false;
+        buffer_begin = buffer_end = buffer;
+        readMore(buffer, 0);
     }
 
     // read bytes from file, and write to buffer + starting_from
     // sets eof = true when there are no more bytes to be read
+    // after eof, toKeep data stays where it was, ends with a newline and is followed by 64 zero bytes
     void readMore(char *toKeep, size_t toKeepSize) {
+        // a row filling more than half of the buffer is copied to one twice as large, so that every read adds at least as many bytes
+        // as are kept, and a long row is re-parsed O(log(size)) times, not O(size / BUFF_SIZE_TOTAL) times
+        // the new buffer only replaces this one once data was read into it, at eof toKeep data has to stay where it was
+        std::unique_ptr<char[]> grown;
+        if (unlikely(toKeepSize > buffer_size / 2)) grown.reset(new char[2 * buffer_size + 1 + 64]);
+
+        char *target = grown ? grown.get() : buffer;
+        const size_t target_size = grown ? 2 * buffer_size : buffer_size;
+
         // copy toKeep data exactly before the data we'll read below
-        memmove(buffer, toKeep, toKeepSize);
-        buffer_end = buffer + toKeepSize;
+        memmove(target, toKeep, toKeepSize);
+        buffer_end = target + toKeepSize;
 
-        int readSize = read(fd, buffer_end, BUFF_SIZE_TOTAL - toKeepSize);
+        ssize_t readSize = read(fd, buffer_end, target_size - toKeepSize);
         assert(readSize != -1);
 
         if (unlikely(readSize == 0)) {
             eof = true;
 
             // move the copied data back to the original position
-            memmove(toKeep, buffer, toKeepSize);
+            memmove(toKeep, target, toKeepSize);
             buffer_end = toKeep + toKeepSize;
 
+            // terminate the last row if the file does not end with a newline
+            if (toKeepSize && buffer_end[-1] != '\n') *buffer_end++ = '\n';
+
             memset(buffer_end, 0, 64); // clear last 64 bytes
+            return;
+        }
+
+        if (unlikely(grown)) {
+            storage = std::move(grown);
+            buffer = buffer_begin = storage.get();
+            buffer_size *= 2;
         }
 
         buffer_end += readSize;
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#include "fastCSV.hpp"
+#include "mmapReadBuffer.hpp"
+
+// the byte offset of every EVERY-th row of an uncompressed file (rows 0, EVERY, 2 * EVERY...) and its number of rows, for FastCSV::seekToRow()
+// rows are counted by the parser, so quoted newlines do not start rows, which is why it depends on the quote and escape of the dialect
+// the index is built once with a full pass over the file, and saved next to it as <path>.fcrows (8 bytes every EVERY rows)
+class RowIndex {
+public:
+    static constexpr uint64_t EVERY = 1024;
+
+    uint64_t rows = 0; // number of rows of the file, the header included
+    std::vector<uint64_t> offsets; // of rows 0, EVERY, 2 * EVERY...
+
+    // returns the index of the file, loaded from its sidecar file, or built (and saved, if possible)
+    // indexes are cached, so readers of the same file on several threads share one
+    template<class CSVDialect = Dialect<>>
+    static std::shared_ptr<const RowIndex> open(const char *path) {
+        static std::mutex mutex;
+        static std::map<std::string, std::shared_ptr<const RowIndex>> cache;
+
+        std::lock_guard lock{mutex};
+        auto &index = cache[std::string{path} + '\0' + CSVDialect::QUOTE + CSVDialect::ESCAPE];
+
+        if (!index) {
+            const std::string index_path = std::string{path} + ".fcrows";
+
+            struct stat file_stat{};
+            [[maybe_unused]] const int stat_result = stat(path, &file_stat);
+            assert(stat_result == 0);
+
+            auto loaded = std::make_shared<RowIndex>();
+            if (!loaded->load(index_path.c_str(), file_stat, CSVDialect::QUOTE, CSVDialect::ESCAPE)) {
+                loaded->build<CSVDialect>(path);
+                loaded->save(index_path.c_str(), file_stat, CSVDialect::QUOTE, CSVDialect::ESCAPE); // only an optimisation, ignore failures
+            }
+            index = std::move(loaded);
+        }
+
+        return index;
+    }
+
+    // last indexed row at or before the given row, and its offset
+    [[nodiscard]] std::pair<uint64_t, uint64_t> rowBefore(uint64_t row) const {
+        if (offsets.empty()) return {0, 0};
+
+        const uint64_t point = std::min<uint64_t>(row / EVERY, offsets.size() - 1);
+        return {point * EVERY, offsets[point]};
+    }
+
+private:
+    // identifies the sidecar format, and the file and dialect it was built for
+    struct Header {
+        char magic[8];
+        uint64_t file_size;
+        int64_t file_mtime;
+        char quote;
+        char escape;
+        uint64_t rows;
+        uint64_t offsets;
+    };
+    static constexpr char MAGIC[8] = {'F', 'C', 'S', 'V', 'R', 'O', 'W', '1'};
+
+    // only the first column is recorded, the rows are parsed from the mapped file, which starts with row 0
+    template<class CSVDialect>
+    void build(const char *path) {
+        auto csv = std::make_unique<FastCSV<DYNAMIC_COLUMNS, MmapReadBuffer, CSVDialect>>(path, Projection{0});
+        const char *const data = csv->finished() ? nullptr : csv->getRow().getRaw().data();
+
+        for (const auto &row : *csv) {
+            if (rows % EVERY == 0) offsets.push_back(row.getRaw().data() - data);
+            ++rows;
+        }
+    }
+
+    bool save(const char *index_path, const struct stat &file_stat, char quote, char escape) const {
+        FILE *file = fopen(index_path, "wb");
+        if (!file) return false;
+
+        Header header{};
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.file_size = file_stat.st_size;
+        header.file_mtime = file_stat.st_mtime;
+        header.quote = quote;
+        header.escape = escape;
+        header.rows = rows;
+        header.offsets = offsets.size();
+
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        ok = ok && fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file) == offsets.size();
+
+        ok = fclose(file) == 0 && ok;
+        if (!ok) unlink(index_path);
+        return ok;
+    }
+
+    // fails if the sidecar file is missing, or was built for another version of the file or another dialect
+    bool load(const char *index_path, const struct stat &file_stat, char quote, char escape) {
+        FILE *file = fopen(index_path, "rb");
+        if (!file) return false;
+
+        Header header{};
+        bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                  header.file_size == (uint64_t) file_stat.st_size && header.file_mtime == file_stat.st_mtime &&
+                  header.quote == quote && header.escape == escape &&
+                  header.offsets == (header.rows + EVERY - 1) / EVERY;
+
+        if (ok) {
+            rows = header.rows;
+            offsets.resize(header.offsets);
+            ok = fread(offsets.data(), sizeof(uint64_t), offsets.size(), file) == offsets.size();
+        }
+
+        fclose(file);
+        if (!ok) {
+            rows = 0;
+            offsets.clear();
+        }
+        return ok;
+    }
+};
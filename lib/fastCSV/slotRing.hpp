@@ -0,0 +1,206 @@
+#pragma once
+
+#include <sys/types.h>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifndef unlikely
+#define unlikely(x) __builtin_expect(!!(x), 0)
+#endif
+
+// the parsing side of the ReadBuffers that fill a ring of slots ahead of the parser (PrefetchReadBuffer, PipelinedGzipReadBuffer, IoUringReadBuffer)
+// readMore() switches to the next slot once it is filled, and copies the unparsed data exactly before it, so rows spanning two slots stay contiguous
+// Source is the ReadBuffer, which provides:
+//   size_t waitForSlot(unsigned slot): waits until the slot is filled, and returns its size (0 at the end of the file)
+//   char *slotData(unsigned slot): the data of the slot, preceded by BUFF_SIZE_TOTAL bytes for the kept data, and followed by 1 + 64 bytes
+//   void releaseSlot(unsigned slot): the parser is done with the slot, which can be filled again
+template<class Source, unsigned slot_count>
+class SlotRing {
+protected:
+    static constexpr size_t BUFF_SIZE_MB = 1;
+    static constexpr size_t BUFF_SIZE_TOTAL = BUFF_SIZE_MB * (1U << 20U);
+
+    // the slot being parsed, the first call of readMore() switches to slot 0
+    unsigned current_slot = slot_count - 1;
+
+    // called by the constructor of Source once its slots can be filled
+    void start() {
+        buffer_begin = buffer_end = source().slotData(current_slot);
+        readMore(buffer_begin, 0);
+    }
+
+private:
+    // rows longer than BUFF_SIZE_TOTAL do not fit before a slot, they are gathered here with the data of the next slots instead
+    // + 1 for the newline appended to an unterminated last row, + 64 zeroed bytes for SIMD reads past buffer_end
+    size_t spill_size = 0;
+    std::unique_ptr<char[]> spill;
+
+    Source &source() { return static_cast<Source &>(*this); }
+
+    // the next slot becomes the current one, the current one can be filled again
+    void nextSlot() {
+        source().releaseSlot(current_slot);
+        current_slot = (current_slot + 1) % slot_count;
+    }
+
+    // copies toKeep data to spill, followed by the data of the next slots until at least as many bytes were added as kept
+    // so a long row is re-parsed O(log(size)) times, not once per slot
+    void spillRow(const char *toKeep, size_t toKeepSize) {
+        // toKeep data may already be in spill, when the row did not end in the previous call either
+        const size_t needed = 2 * toKeepSize + BUFF_SIZE_TOTAL;
+        if (spill_size < needed) {
+            std::unique_ptr<char[]> grown{new char[needed + 1 + 64]};
+            memcpy(grown.get(), toKeep, toKeepSize);
+
+            spill = std::move(grown);
+            spill_size = needed;
+        } else {
+            memmove(spill.get(), toKeep, toKeepSize);
+        }
+
+        buffer_begin = spill.get();
+        buffer_end = buffer_begin + toKeepSize;
+
+        while (buffer_end - buffer_begin < (ssize_t) (2 * toKeepSize)) {
+            const size_t size = source().waitForSlot((current_slot + 1) % slot_count);
+            if (!size) break; // a slot of size 0 (end of file) is left for the next call
+            nextSlot();
+
+            memcpy(buffer_end, source().slotData(current_slot), size);
+            buffer_end += size;
+        }
+    }
+
+public:
+    char *buffer_begin = nullptr;
+    char *buffer_end = nullptr;
+
+    bool eof = false;
+
+    // switch to the next slot once it is filled, and copy toKeep data exactly before its data
+    // sets eof = true when there are no more bytes to be read
+    // after eof, toKeep data stays where it was, ends with a newline and is followed by 64 zero bytes
+    void readMore(char *toKeep, size_t toKeepSize) {
+        const unsigned next_slot = (current_slot + 1) % slot_count;
+        const size_t size = source().waitForSlot(next_slot);
+
+        if (unlikely(size == 0)) {
+            eof = true;
+
+            // terminate the last row if the file does not end with a newline
+            if (toKeepSize && buffer_end[-1] != '\n') *buffer_end++ = '\n';
+
+            memset(buffer_end, 0, 64); // clear last 64 bytes
+            return;
+        }
+
+        if (unlikely(toKeepSize > BUFF_SIZE_TOTAL)) {
+            spillRow(toKeep, toKeepSize);
+            return;
+        }
+
+        char *const data = source().slotData(next_slot);
+        buffer_begin = data - toKeepSize;
+        memcpy(buffer_begin, toKeep, toKeepSize);
+        buffer_end = data + size;
+
+        nextSlot();
+    }
+};
+
+// a SlotRing filled in order by a helper thread, which keeps the next SLOTS - 1 slots filled while the current one is parsed
+// readMore() only waits if the helper thread falls behind
+// Source provides size_t fill(char *data), called on the helper thread: writes up to BUFF_SIZE_TOTAL bytes of the file to data, returns their number (0 at the end)
+// it calls start() in its constructor once fill() can be called, and stop() first in its destructor, before the members fill() uses are released
+template<class Source>
+class ThreadSlotRing : public SlotRing<ThreadSlotRing<Source>, 3> {
+    friend class SlotRing<ThreadSlotRing, 3>;
+    using Ring = SlotRing<ThreadSlotRing, 3>;
+
+protected:
+    using Ring::BUFF_SIZE_TOTAL;
+    static constexpr unsigned SLOTS = 3;
+
+private:
+    // slot state, besides the number of bytes filled (0 meaning end of file)
+    static constexpr ssize_t SLOT_EMPTY = -1;
+    static constexpr ssize_t SLOT_IN_USE = -2;
+
+    // every slot reserves BUFF_SIZE_TOTAL bytes before its data, where the unparsed part of the previous slot is copied
+    // + 1 for the newline appended to an unterminated last row, + 64 zeroed bytes for SIMD reads past buffer_end
+    struct Slot {
+        char toKeep[BUFF_SIZE_TOTAL];
+        char data[BUFF_SIZE_TOTAL + 1 + 64];
+    } slots[SLOTS]{};
+
+    ssize_t slot_state[SLOTS]{};
+
+    std::mutex mutex;
+    std::condition_variable slot_filled;
+    std::condition_variable slot_emptied;
+    bool stopping = false;
+
+    std::thread filler;
+
+    // fills slots in order, waiting for the parser to release them
+    void fillerLoop() {
+        for (unsigned slot = 0;; slot = (slot + 1) % SLOTS) {
+            {
+                std::unique_lock lock{mutex};
+                slot_emptied.wait(lock, [&] { return stopping || slot_state[slot] == SLOT_EMPTY; });
+                if (stopping) return;
+            }
+
+            const size_t size = static_cast<Source *>(this)->fill(slots[slot].data);
+
+            {
+                std::lock_guard lock{mutex};
+                slot_state[slot] = (ssize_t) size;
+            }
+            slot_filled.notify_one();
+
+            if (size == 0) return;
+        }
+    }
+
+    // waits until the helper thread is done with a slot, returns its size
+    size_t waitForSlot(unsigned slot) {
+        std::unique_lock lock{mutex};
+        slot_filled.wait(lock, [&] { return slot_state[slot] >= 0; });
+        return slot_state[slot];
+    }
+
+    [[nodiscard]] char *slotData(unsigned slot) { return slots[slot].data; }
+
+    // the helper thread can now reuse the slot
+    void releaseSlot(unsigned slot) {
+        {
+            std::lock_guard lock{mutex};
+            slot_state[slot] = SLOT_EMPTY;
+        }
+        slot_emptied.notify_one();
+    }
+
+protected:
+    // starts the helper thread, the current slot is not filled before the parser releases it
+    void start() {
+        for (auto &state : slot_state) state = SLOT_EMPTY;
+        slot_state[this->current_slot] = SLOT_IN_USE;
+
+        filler = std::thread{&ThreadSlotRing::fillerLoop, this};
+        Ring::start();
+    }
+
+    // stops the helper thread, fill() is not called anymore
+    void stop() {
+        {
+            std::lock_guard lock{mutex};
+            stopping = true;
+        }
+        slot_emptied.notify_one();
+        filler.join();
+    }
+};
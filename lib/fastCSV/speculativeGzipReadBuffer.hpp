@@ -0,0 +1,377 @@
+#pragma once
+
+#include <string_view>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "../zlib/zlib.h"
+#include "symbolicInflate.hpp"
+
+#ifndef unlikely
+#define unlikely(x) __builtin_expect(!!(x), 0)
+#endif
+
+// inflates a single gzip member on several threads, without an index (like pugz)
+// the compressed file is split in CHUNK_SIZE ranges, and each worker thread guesses the first deflate block starting in its range:
+// a dynamic Huffman block which decodes to ASCII text only, which is very unlikely for a false match
+// chunks are inflated with SymbolicInflate, as the 32KB window before them is unknown, up to the block start of the next chunk
+// the parser side then resolves the symbols of each chunk with the last 32KB of the previous one, and checks the CRC of the member
+// when a guessed start turns out to be wrong (the previous chunk went past it), that chunk is decoded again by the previous one
+// any data after the first member (appended files) is inflated serially
+class SpeculativeGzipReadBuffer {
+private:
+    static constexpr size_t BUFF_SIZE_MB = 1;
+    static constexpr size_t BUFF_SIZE_TOTAL = BUFF_SIZE_MB * (1U << 20U);
+
+    // compressed bytes per chunk
+    static constexpr size_t CHUNK_SIZE = 1U << 20U;
+
+    // zlib takes at most UINT_MAX input bytes per call
+    static constexpr size_t MAX_AVAIL_IN = 1U << 30U;
+
+    static constexpr uint64_t NO_BLOCK = UINT64_MAX;
+
+    int fd = -1;
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+
+    // + 1 for the newline appended to an unterminated last row, + 64 zeroed bytes for SIMD reads past buffer_end
+    // starts at BUFF_SIZE_TOTAL bytes, and doubles whenever a row fills more than half of it
+    size_t buffer_size = BUFF_SIZE_TOTAL;
+    std::unique_ptr<char[]> storage{new char[BUFF_SIZE_TOTAL + 1 + 64]{}};
+    char *buffer = storage.get();
+
+    // first block start (in bits) of every chunk, guessed once by whichever thread needs it first
+    size_t chunk_count = 0;
+    std::unique_ptr<uint64_t[]> block_starts;
+    std::unique_ptr<std::once_flag[]> block_starts_found;
+
+    // chunk results, indexed by chunk % chunks.size()
+    struct Chunk {
+        size_t index = SIZE_MAX; // set once the result is published
+        bool ok = false;
+        bool member_end = false; // the last block of the member is in this chunk, which then ends at end_position
+        size_t next_chunk = 0; // otherwise, the chunk whose block start this one ended at
+        uint64_t end_position = 0;
+        std::vector<uint16_t> symbols; // starting with the SymbolicInflate window symbols
+        size_t symbols_size = 0;
+    };
+    std::vector<Chunk> chunks;
+    size_t next_chunk = 0; // next chunk to be picked by a worker
+    size_t current_chunk = 0; // chunk being resolved, results of previous chunks are discarded
+
+    std::mutex mutex;
+    std::condition_variable chunk_published;
+    std::condition_variable chunk_consumed;
+    bool stopping = false;
+
+    std::vector<std::thread> workers;
+
+    // parser side state
+    Chunk chunk; // chunk being resolved and copied to the buffer
+    const uint16_t *symbols_pos = nullptr;
+    const uint16_t *symbols_end = nullptr;
+    char window[SymbolicInflate::WINDOW_SIZE]{}; // the output before the current chunk
+    uint32_t crc = 0;
+    uint32_t member_size = 0; // modulo 2^32, like the gzip trailer
+    bool member_done = false;
+
+    bool serial = false; // inflating the members after the first one on this thread
+    size_t position = 0; // compressed offset of the serial inflator
+    z_stream serial_inflator{};
+
+    // offset of the deflate data after the gzip header at the start of the file
+    [[nodiscard]] size_t headerSize() const {
+        assert(size >= 18 && data[0] == 0x1f && data[1] == 0x8b && data[2] == 8);
+
+        const uint8_t flags = data[3];
+        size_t offset = 10;
+
+        if (flags & 4U) offset += 2 + (data[10] | (data[11] << 8U)); // FEXTRA
+        if (flags & 8U) offset = (const uint8_t *) memchr(data + offset, 0, size - offset) - data + 1; // FNAME
+        if (flags & 16U) offset = (const uint8_t *) memchr(data + offset, 0, size - offset) - data + 1; // FCOMMENT
+        if (flags & 2U) offset += 2; // FHCRC
+
+        assert(offset < size);
+        return offset;
+    }
+
+    // search is only used to guess block starts, so its state can be lost
+    uint64_t blockStart(size_t index, SymbolicInflate &search) {
+        std::call_once(block_starts_found[index], [&] {
+            // the first chunk starts at the known first block
+            if (index == 0) block_starts[0] = headerSize() * 8;
+            else block_starts[index] = search.findBlock(index * CHUNK_SIZE * 8, std::min((index + 1) * CHUNK_SIZE, size) * 8);
+        });
+
+        return block_starts[index];
+    }
+
+    // first chunk at or after index with a block start, chunk_count if there is none
+    size_t nextStart(size_t index, SymbolicInflate &search) {
+        while (index < chunk_count && blockStart(index, search) == NO_BLOCK) ++index;
+        return index;
+    }
+
+    // inflates from the block start of the chunk up to the block start of the next chunk, or to the end of the member
+    void runChunk(size_t index, SymbolicInflate &inflate, SymbolicInflate &search, Chunk &result) {
+        const uint64_t start = blockStart(index, search);
+        if (start == NO_BLOCK) return;
+
+        inflate.reset(start);
+        size_t target = nextStart(index + 1, search);
+
+        while (true) {
+            // a block start of a following chunk which was skipped over was a false match
+            while (target < chunk_count && inflate.position > block_starts[target]) target = nextStart(target + 1, search);
+
+            if (target < chunk_count && inflate.position == block_starts[target]) {
+                result.next_chunk = target;
+                break;
+            }
+
+            const SymbolicInflate::Status status = inflate.block();
+            if (status == SymbolicInflate::Status::ERROR) return;
+            if (status == SymbolicInflate::Status::FINAL_BLOCK_END) {
+                result.member_end = true;
+                result.end_position = inflate.position;
+                break;
+            }
+        }
+
+        result.ok = true;
+        result.symbols_size = inflate.output_size;
+        result.symbols = inflate.takeOutput();
+    }
+
+    // picks chunks in order, at most chunks.size() ahead of the parser
+    void workerLoop() {
+        SymbolicInflate inflate{data, size}, search{data, size};
+
+        while (true) {
+            size_t index;
+            {
+                std::unique_lock lock{mutex};
+                chunk_consumed.wait(lock, [&] {
+                    return stopping || next_chunk >= chunk_count || next_chunk < current_chunk + chunks.size();
+                });
+                if (stopping || next_chunk >= chunk_count) break;
+
+                next_chunk = std::max(next_chunk, current_chunk);
+                index = next_chunk++;
+            }
+
+            Chunk result;
+            runChunk(index, inflate, search, result);
+
+            {
+                std::lock_guard lock{mutex};
+                // the parser may have skipped this chunk while it was running
+                if (index >= current_chunk) {
+                    result.index = index;
+                    chunks[index % chunks.size()] = std::move(result);
+                }
+            }
+            chunk_published.notify_all();
+        }
+    }
+
+    // called once the current chunk was copied: moves on to the chunk it ended at, or finishes the member
+    void nextChunk() {
+        // the window of the next chunk is the end of this one, resolved with its own window
+        if (chunk.ok) {
+            char next_window[SymbolicInflate::WINDOW_SIZE];
+            resolve(chunk.symbols.data() + chunk.symbols_size - SymbolicInflate::WINDOW_SIZE, next_window, SymbolicInflate::WINDOW_SIZE);
+            memcpy(window, next_window, SymbolicInflate::WINDOW_SIZE);
+
+            if (chunk.member_end) {
+                finishMember();
+                return;
+            }
+        }
+
+        const size_t index = chunk.ok ? chunk.next_chunk : 0;
+        Chunk &published = chunks[index % chunks.size()];
+
+        {
+            std::unique_lock lock{mutex};
+            current_chunk = index;
+            chunk_consumed.notify_all();
+            chunk_published.wait(lock, [&] { return published.index == index; });
+        }
+
+        // chunks are only used if the previous one ended at their block start, so this one starts at a real block
+        assert(published.ok);
+        chunk = std::move(published);
+        symbols_pos = chunk.symbols.data() + SymbolicInflate::WINDOW_SIZE;
+        symbols_end = chunk.symbols.data() + chunk.symbols_size;
+    }
+
+    // checks the gzip trailer of the member, and continues serially if other members follow
+    void finishMember() {
+        member_done = true;
+
+        position = (chunk.end_position + 7) / 8;
+        assert(position + 8 <= size);
+
+        uint32_t trailer[2];
+        memcpy(trailer, data + position, 8);
+        assert(trailer[0] == crc && trailer[1] == member_size);
+
+        position += 8;
+        serial = position != size;
+        chunk = Chunk{};
+    }
+
+    void resolve(const uint16_t *symbols, char *out, size_t count) const {
+        for (size_t i = 0; i < count; ++i) {
+            const uint16_t symbol = symbols[i];
+            out[i] = (char) (symbol < SymbolicInflate::WINDOW_SYMBOL ? symbol : window[symbol - SymbolicInflate::WINDOW_SYMBOL]);
+        }
+    }
+
+    // inflates the next part of the remaining members into the buffer, on this thread
+    void inflateSerial() {
+        serial_inflator.avail_in = std::min(size - position, MAX_AVAIL_IN);
+        serial_inflator.next_in = (uint8_t *) data + position;
+        serial_inflator.avail_out = buffer + buffer_size - buffer_end;
+        serial_inflator.next_out = (uint8_t *) buffer_end;
+
+        int status = inflate(&serial_inflator, Z_SYNC_FLUSH);
+        assert(status == Z_OK || status == Z_STREAM_END);
+        buffer_end = (char *) serial_inflator.next_out;
+        position = serial_inflator.next_in - data;
+
+        if (status == Z_STREAM_END) {
+            if (position == size) {
+                serial = false;
+            } else { // appended file
+                status = inflateReset(&serial_inflator);
+                assert(status == Z_OK);
+            }
+        }
+    }
+
+    // replaces the buffer with one twice as large, starting with the toKeep data
+    void grow(char *&toKeep, size_t toKeepSize) {
+        std::unique_ptr<char[]> grown{new char[2 * buffer_size + 1 + 64]};
+        memcpy(grown.get(), toKeep, toKeepSize);
+
+        storage = std::move(grown);
+        buffer = buffer_begin = toKeep = storage.get();
+        buffer_size *= 2;
+    }
+
+public:
+    char *buffer_begin = buffer;
+    char *buffer_end = buffer;
+
+    bool eof = false;
+
+    // open and map file, and start the worker threads when object is created
+    explicit SpeculativeGzipReadBuffer(const char *path) {
+        fd = open(path, O_RDONLY);
+        assert(fd != -1);
+
+        struct stat file_stat{};
+        [[maybe_unused]] const int stat_result = fstat(fd, &file_stat);
+        assert(stat_result == 0);
+        size = file_stat.st_size;
+
+        // + 16 for gzip header & footer parsing
+        [[maybe_unused]] const int status = inflateInit2(&serial_inflator, 15 + 16);
+        assert(status == Z_OK);
+
+        if (!size) {
+            member_done = true;
+            readMore(buffer, 0);
+            return;
+        }
+
+        data = (const uint8_t *) mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        assert(data != MAP_FAILED);
+
+        chunk_count = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        block_starts.reset(new uint64_t[chunk_count]);
+        block_starts_found.reset(new std::once_flag[chunk_count]);
+
+        const unsigned threads = std::max(std::thread::hardware_concurrency(), 1U);
+        chunks.resize(2 * threads);
+
+        for (unsigned i = 0; i < threads; ++i) workers.emplace_back(&SpeculativeGzipReadBuffer::workerLoop, this);
+
+        readMore(buffer, 0);
+    }
+
+    // stop the worker threads, unmap and close the file when this object is deleted
+    ~SpeculativeGzipReadBuffer() {
+        {
+            std::lock_guard lock{mutex};
+            stopping = true;
+        }
+        chunk_consumed.notify_all();
+        for (auto &worker : workers) worker.join();
+
+        [[maybe_unused]] int result = inflateEnd(&serial_inflator);
+        assert(result == Z_OK);
+        if (size) {
+            result = munmap((void *) data, size);
+            assert(result == 0);
+        }
+        result = close(fd);
+        assert(result == 0);
+    }
+
+    // copy inflated data in file order to buffer, after toKeep data
+    // sets eof = true when there are no more bytes to be read
+    // after eof, toKeep data stays where it was, ends with a newline and is followed by 64 zero bytes
+    void readMore(char *toKeep, size_t toKeepSize) {
+        if (unlikely(symbols_pos == symbols_end && member_done && !serial)) {
+            eof = true;
+
+            // terminate the last row if the file does not end with a newline
+            if (toKeepSize && buffer_end[-1] != '\n') *buffer_end++ = '\n';
+
+            memset(buffer_end, 0, 64); // clear last 64 bytes
+            return;
+        }
+
+        // a row filling more than half of the buffer is moved to one twice as large, so that every call adds at least as many bytes
+        // as are kept, and a long row is re-parsed O(log(size)) times, not O(size / BUFF_SIZE_TOTAL) times
+        if (unlikely(toKeepSize > buffer_size / 2)) grow(toKeep, toKeepSize);
+
+        // copy toKeep data exactly before the data we'll add below
+        memmove(buffer, toKeep, toKeepSize);
+        buffer_end = buffer + toKeepSize;
+
+        while (buffer_end != buffer + buffer_size) {
+            if (symbols_pos != symbols_end) {
+                const size_t copySize = std::min<size_t>(symbols_end - symbols_pos, buffer + buffer_size - buffer_end);
+                resolve(symbols_pos, buffer_end, copySize);
+
+                crc = crc32(crc, (const Bytef *) buffer_end, copySize);
+                member_size += copySize;
+
+                buffer_end += copySize;
+                symbols_pos += copySize;
+            } else if (serial) {
+                inflateSerial();
+            } else if (!member_done) {
+                nextChunk();
+            } else {
+                break;
+            }
+        }
+    }
+};
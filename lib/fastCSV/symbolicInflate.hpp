@@ -0,0 +1,340 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+#ifndef likely
+#define likely(x) __builtin_expect(!!(x), 1)
+#endif
+#ifndef unlikely
+#define unlikely(x) __builtin_expect(!!(x), 0)
+#endif
+
+// deflate decoder which can start at any block boundary of a stream, without knowing the 32KB window before it
+// it outputs 16 bit symbols: values below 256 are bytes, and WINDOW_SYMBOL + i is the byte at position i of the unknown window
+// once the window is known (the last WINDOW_SIZE bytes inflated before the start position), symbols are resolved to bytes
+// invalid data never crashes the decoder, it is reported as an ERROR, so it can be used to check guessed block starts
+class SymbolicInflate {
+public:
+    static constexpr size_t WINDOW_SIZE = 32768;
+    static constexpr uint16_t WINDOW_SYMBOL = 256;
+
+    enum class Status { BLOCK_END, FINAL_BLOCK_END, ERROR };
+
+    // output starts with the WINDOW_SIZE symbols of the unknown window, followed by the decoded symbols
+    std::vector<uint16_t> output;
+    size_t output_size = WINDOW_SIZE;
+
+    // position in bits in the compressed data
+    uint64_t position = 0;
+
+    SymbolicInflate(const uint8_t *data, size_t size) : data{data}, size{size} {
+        takeOutput();
+    }
+
+    // start decoding at a block boundary, with an unknown window
+    void reset(uint64_t bit_position) {
+        position = bit_position;
+        output_size = WINDOW_SIZE;
+    }
+
+    // moves the output out (output_size symbols are valid), the decoder continues with a new one
+    std::vector<uint16_t> takeOutput() {
+        std::vector<uint16_t> taken(4 * WINDOW_SIZE);
+        std::swap(taken, output);
+
+        for (size_t i = 0; i < WINDOW_SIZE; ++i) output[i] = WINDOW_SYMBOL + i;
+        return taken;
+    }
+
+    // decodes the next block
+    // with check_text, the block also has to be a dynamic Huffman block made of ASCII text only, which makes guessed block starts reliable
+    template<bool check_text = false>
+    Status block() {
+        const uint64_t header = peek();
+        const bool final_block = header & 1U;
+        const unsigned type = (header >> 1U) & 3U;
+
+        if constexpr (check_text) {
+            if (final_block || type != 2) return Status::ERROR;
+        }
+
+        position += 3;
+
+        bool ok;
+        switch (type) {
+            case 0:
+                ok = storedBlock();
+                break;
+            case 1:
+                ok = huffmanBlock<check_text>(fixedTables().literals, fixedTables().distances);
+                break;
+            case 2:
+                ok = dynamicTables() && huffmanBlock<check_text>(literals, distances);
+                break;
+            default:
+                ok = false;
+        }
+
+        if (!ok || position > size * 8) return Status::ERROR;
+        return final_block ? Status::FINAL_BLOCK_END : Status::BLOCK_END;
+    }
+
+    // first position in [from, to) where a block that passes block<true>() starts, or UINT64_MAX
+    uint64_t findBlock(uint64_t from, uint64_t to) {
+        for (uint64_t candidate = from; candidate < to; ++candidate) {
+            // not final, dynamic Huffman block: the 3 header bits are 0, 0, 1
+            position = candidate;
+            if ((peek() & 7U) != 4U) continue;
+
+            reset(candidate);
+            if (block<true>() == Status::BLOCK_END) {
+                reset(candidate);
+                return candidate;
+            }
+        }
+
+        return UINT64_MAX;
+    }
+
+private:
+    const uint8_t *data;
+    size_t size;
+
+    // Huffman decoding table indexed by the next bits of input, entries are (symbol << 4) | code length, 0 for invalid codes
+    struct Huffman {
+        uint16_t table[1U << 15U];
+        unsigned bits = 0;
+
+        // builds the canonical Huffman code, fails on over-subscribed or (except a single code of length 1) incomplete codes
+        bool build(const uint8_t *lengths, unsigned count, bool complete = false) {
+            unsigned counts[16]{};
+            for (unsigned symbol = 0; symbol < count; ++symbol) counts[lengths[symbol]]++;
+            counts[0] = 0;
+
+            unsigned max = 15;
+            while (max > 0 && counts[max] == 0) --max;
+
+            if (max == 0) { // no codes at all, which is valid for distances of a block made only of literals
+                bits = 1;
+                table[0] = table[1] = 0;
+                return !complete;
+            }
+
+            int left = 1;
+            for (unsigned length = 1; length <= 15; ++length) {
+                left = (left << 1) - (int) counts[length];
+                if (left < 0) return false;
+            }
+            if (left > 0 && (complete || max != 1)) return false;
+
+            unsigned next_code[16]{};
+            for (unsigned length = 1, code = 0; length <= 15; ++length) {
+                code = (code + counts[length - 1]) << 1U;
+                next_code[length] = code;
+            }
+
+            bits = max;
+            memset(table, 0, sizeof(uint16_t) << bits);
+
+            for (unsigned symbol = 0; symbol < count; ++symbol) {
+                const unsigned length = lengths[symbol];
+                if (!length) continue;
+
+                // codes are stored starting from their most significant bit
+                unsigned code = next_code[length]++, reversed = 0;
+                for (unsigned i = 0; i < length; ++i, code >>= 1U) reversed = (reversed << 1U) | (code & 1U);
+
+                for (unsigned index = reversed; index < (1U << bits); index += 1U << length)
+                    table[index] = (uint16_t) ((symbol << 4U) | length);
+            }
+
+            return true;
+        }
+
+        [[nodiscard]] inline __attribute__((always_inline)) uint16_t decode(uint64_t input) const {
+            return table[input & ((1U << bits) - 1)];
+        }
+    };
+
+    Huffman literals;
+    Huffman distances;
+
+    struct FixedTables {
+        Huffman literals;
+        Huffman distances;
+
+        FixedTables() {
+            uint8_t lengths[288];
+            for (unsigned symbol = 0; symbol < 288; ++symbol)
+                lengths[symbol] = symbol < 144 ? 8 : symbol < 256 ? 9 : symbol < 280 ? 7 : 8;
+            literals.build(lengths, 288);
+
+            // 32 codes keep the code complete, symbols 30 and 31 are rejected when decoding
+            for (auto &length : lengths) length = 5;
+            distances.build(lengths, 32);
+        }
+    };
+
+    static const FixedTables &fixedTables() {
+        static const FixedTables tables;
+        return tables;
+    }
+
+    // the next 57 bits of input, zeroes past the end of the data
+    [[nodiscard]] inline __attribute__((always_inline)) uint64_t peek() const {
+        const size_t byte = position >> 3U;
+
+        uint64_t bits = 0;
+        if (likely(byte + 8 <= size)) memcpy(&bits, data + byte, 8);
+        else if (byte < size) memcpy(&bits, data + byte, size - byte);
+
+        return bits >> (position & 7U);
+    }
+
+    inline __attribute__((always_inline)) unsigned readBits(unsigned count) {
+        const unsigned value = (unsigned) (peek() & ((1ULL << count) - 1));
+        position += count;
+        return value;
+    }
+
+    inline __attribute__((always_inline)) void reserveOutput(size_t count) {
+        if (unlikely(output_size + count > output.size())) output.resize(output.size() * 2);
+    }
+
+    bool storedBlock() {
+        position = (position + 7) & ~7ULL;
+        if ((position >> 3U) + 4 > size) return false;
+
+        const unsigned length = readBits(16);
+        const unsigned length_complement = readBits(16);
+        if (length != (~length_complement & 0xffffU) || (position >> 3U) + length > size) return false;
+
+        reserveOutput(length);
+        const uint8_t *input = data + (position >> 3U);
+        for (unsigned i = 0; i < length; ++i) output[output_size + i] = input[i];
+
+        output_size += length;
+        position += length * 8ULL;
+        return true;
+    }
+
+    // reads the code lengths of a dynamic block header, and builds its tables
+    bool dynamicTables() {
+        static constexpr uint8_t ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+        const unsigned literal_count = readBits(5) + 257;
+        const unsigned distance_count = readBits(5) + 1;
+        const unsigned code_count = readBits(4) + 4;
+        if (literal_count > 286 || distance_count > 30) return false;
+
+        uint8_t code_lengths[19]{};
+        for (unsigned i = 0; i < code_count; ++i) code_lengths[ORDER[i]] = readBits(3);
+
+        Huffman &codes = distances; // reused, the distance table is built after the code lengths are read
+        if (!codes.build(code_lengths, 19, true)) return false;
+
+        uint8_t lengths[286 + 30];
+        for (unsigned i = 0; i < literal_count + distance_count;) {
+            const uint64_t input = peek();
+            const uint16_t entry = codes.decode(input);
+            const unsigned length = entry & 15U, symbol = entry >> 4U;
+            if (!length) return false;
+            position += length;
+
+            if (symbol < 16) {
+                lengths[i++] = symbol;
+                continue;
+            }
+
+            unsigned repeat;
+            uint8_t value = 0;
+            if (symbol == 16) {
+                if (i == 0) return false;
+                value = lengths[i - 1];
+                repeat = 3 + readBits(2);
+            } else if (symbol == 17) {
+                repeat = 3 + readBits(3);
+            } else {
+                repeat = 11 + readBits(7);
+            }
+
+            if (i + repeat > literal_count + distance_count) return false;
+            while (repeat--) lengths[i++] = value;
+        }
+
+        // the end of block code is required
+        if (lengths[256] == 0) return false;
+
+        return literals.build(lengths, literal_count) && distances.build(lengths + literal_count, distance_count);
+    }
+
+    template<bool check_text>
+    bool huffmanBlock(const Huffman &literal_table, const Huffman &distance_table) {
+        static constexpr uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83,
+                                                     99, 115, 131, 163, 195, 227, 258};
+        static constexpr uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static constexpr uint16_t DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+                                                       1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+        static constexpr uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+                                                       12, 12, 13, 13};
+
+        const uint64_t end = size * 8;
+
+        while (true) {
+            if (unlikely(position > end)) return false;
+            reserveOutput(258 + 8);
+
+            uint64_t input = peek();
+            const uint16_t entry = literal_table.decode(input);
+            unsigned length = entry & 15U;
+            const unsigned symbol = entry >> 4U;
+            if (unlikely(!length)) return false;
+            input >>= length;
+            position += length;
+
+            if (symbol < 256) {
+                if constexpr (check_text) {
+                    // printable ASCII, tab, line feed or carriage return
+                    if ((symbol < 0x20 || symbol > 0x7e) && symbol != '\t' && symbol != '\n' && symbol != '\r') return false;
+                }
+                output[output_size++] = symbol;
+                continue;
+            }
+            if (symbol == 256) return true;
+            if (unlikely(symbol > 285)) return false;
+
+            // length and distance of the back reference, all in the 57 bits of input (at most 5 + 15 + 13)
+            const unsigned length_code = symbol - 257;
+            const unsigned copy_length = LENGTH_BASE[length_code] + (unsigned) (input & ((1U << LENGTH_EXTRA[length_code]) - 1));
+            input >>= LENGTH_EXTRA[length_code];
+            position += LENGTH_EXTRA[length_code];
+
+            const uint16_t distance_entry = distance_table.decode(input);
+            length = distance_entry & 15U;
+            const unsigned distance_code = distance_entry >> 4U;
+            if (unlikely(!length || distance_code > 29)) return false;
+            input >>= length;
+
+            const unsigned distance = DISTANCE_BASE[distance_code] + (unsigned) (input & ((1U << DISTANCE_EXTRA[distance_code]) - 1));
+            position += length + DISTANCE_EXTRA[distance_code];
+
+            // references before the start reach into the unknown window, which is at most WINDOW_SIZE long
+            if (unlikely(distance > output_size)) return false;
+
+            uint16_t *destination = output.data() + output_size;
+            const uint16_t *source = destination - distance;
+            output_size += copy_length;
+
+            if (distance >= 8) {
+                // 8 symbols at a time, which can write past the copy (reserved space) but never reads what it wrote
+                for (unsigned i = 0; i < copy_length; i += 8) memcpy(destination + i, source + i, 8 * sizeof(uint16_t));
+            } else {
+                // overlapping source and destination repeat the last distance symbols
+                for (unsigned i = 0; i < copy_length; ++i) destination[i] = source[i];
+            }
+        }
+    }
+};
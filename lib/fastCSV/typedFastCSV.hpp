@@ -0,0 +1,89 @@
+#pragma once
+
+#include <memory>
+#include <numeric>
+#include <tuple>
+#include <utility>
+
+#include "fastCSV.hpp"
+
+// the types of the columns of a TypedFastCSV, in order: Schema<int64_t, double, std::string_view, Date>
+// any type supported by row.as<T>() can be used
+template<class... Types>
+struct Schema {
+    using Row = std::tuple<Types...>;
+    static constexpr int COLUMNS = sizeof...(Types);
+};
+
+// parses rows into tuples of the types of the Schema, for the first columns of the file or for the columns of a Projection
+// every row is converted as soon as it is cut from the index, while its bytes are still in cache, instead of calling from_chars() on row[i] afterwards
+// std::string_view columns point into the ReadBuffer, and are valid until the next row is parsed, as with FastCSV
+template<class RowSchema, class ReadBuffer = RawReadBuffer, class CSVDialect = Dialect<>>
+class TypedFastCSV {
+public:
+    using Row = typename RowSchema::Row;
+
+private:
+    // rows can have more columns than the Schema, only those of the projection are recorded
+    using CSV = FastCSV<DYNAMIC_COLUMNS, ReadBuffer, CSVDialect>;
+
+    std::unique_ptr<CSV> csv;
+    Row values{};
+
+    static Projection firstColumns() {
+        std::vector<int> indexes(RowSchema::COLUMNS);
+        std::iota(indexes.begin(), indexes.end(), 0);
+        return Projection{std::move(indexes)};
+    }
+
+    template<size_t... index>
+    void convert(std::index_sequence<index...>) {
+        const auto &row = csv->getRow();
+        ((std::get<index>(values) = row.template as<std::tuple_element_t<index, Row>>((int) index)), ...);
+    }
+
+    // converts the current row, unless the end of the file was reached
+    void convertRow() {
+        if (!csv->finished()) convert(std::make_index_sequence<RowSchema::COLUMNS>{});
+    }
+
+    struct sentinel {
+    };
+
+public:
+    // the first RowSchema::COLUMNS columns of the file, the first row is skipped if it is a header
+    explicit TypedFastCSV(const char *path, bool header = true) : TypedFastCSV(path, firstColumns(), header) {}
+
+    // the columns of the projection (indexes or header names) in order, which has one column per type of the Schema
+    TypedFastCSV(const char *path, Projection projection, bool header = true) : csv{new CSV(path, std::move(projection))} {
+        assert((csv->finished() || csv->getColumns() == RowSchema::COLUMNS) && "projection does not have one column per type of the schema");
+
+        if (header) csv->nextRow();
+        convertRow();
+    }
+    TypedFastCSV(TypedFastCSV &) = delete;
+    TypedFastCSV(TypedFastCSV &&) = delete;
+
+    void nextRow() {
+        csv->nextRow();
+        convertRow();
+    }
+
+    [[nodiscard]] const Row &getRow() const { return values; }
+    [[nodiscard]] bool finished() const { return csv->finished(); }
+
+    /* end-sentinel iterator */
+
+    class iterator {
+    public:
+        explicit iterator(TypedFastCSV *typedCsv) : typedCsv{typedCsv} {}
+        void operator++() { typedCsv->nextRow(); }
+        bool operator!=(const sentinel) const { return !typedCsv->finished(); }
+        const Row &operator*() const { return typedCsv->values; }
+    private:
+        TypedFastCSV *typedCsv{};
+    };
+
+    iterator begin() { return iterator{this}; }
+    sentinel end() { return sentinel{}; }
+};
@@ -4,6 +4,7 @@
 #include "lib/fastCSV/fastCSV.hpp"
 #include "lib/fastCSV/rawReadBuffer.hpp"
 #include "lib/fastCSV/gzipReadBuffer.hpp"
+#include "lib/fastCSV/mmapReadBuffer.hpp"
 
 int main() {
     auto fastCSV = new FastCSV<500, GzipReadBuffer>("../data.csv.gz");
@@ -0,0 +1,243 @@
+#include <charconv>
+#include <ctime>
+#include <limits>
+
+#include "testUtils.hpp"
+#include "../lib/fastCSV/fastCSV.hpp"
+
+// row.as<T>() (padded columns, read past their end) and parseColumn<T>() (any string_view) convert columns as from_chars() does
+
+// every value is both columns of a row, so that it is followed by a delimiter once and by a newline once
+template<class Check>
+static void checkValues(const std::vector<std::string> &values, Check &&check) {
+    std::string data;
+    for (const std::string &value : values) data += value + ',' + value + '\n';
+    TempFile file{data};
+
+    FastCSV<DYNAMIC_COLUMNS> csv(file.c_str());
+    size_t count = 0;
+    for (const auto &row : csv) {
+        CHECK(count < values.size());
+        if (count >= values.size()) break;
+        check(row, values[count++]);
+    }
+    CHECK(count == values.size());
+}
+
+// the value of text as from_chars() reads it (without the quotes of a quoted number), false if it is not a T (which fails an assert)
+template<class T>
+static bool reference(std::string_view text, T &value) {
+    if (text.size() >= 2 && text.front() == '"' && text.back() == '"') text = text.substr(1, text.size() - 2);
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc{} && end == text.data() + text.size() && !text.empty();
+}
+
+template<class T, class Row>
+static void checkInteger(const Row &row, const std::string &text) {
+    T expected{};
+    if (!reference(text, expected)) return;
+
+    CHECK(row.template as<T>(0) == expected);
+    CHECK(row.template as<T>(1) == expected);
+    CHECK(parseColumn<T>(text) == expected);
+}
+
+template<class T>
+static void addLimits(std::vector<std::string> &values) {
+    for (int delta : {0, 1, 2}) {
+        values.push_back(std::to_string(std::numeric_limits<T>::max() - delta));
+        values.push_back(std::to_string(std::numeric_limits<T>::min() + delta));
+    }
+    // one past the limits, which are not a T
+    values.push_back(std::to_string(std::numeric_limits<T>::max()) + "0");
+}
+
+static void checkIntegers() {
+    std::vector<std::string> values{"0", "-0", "7", "-7", "007", "-007", "0000000000000000001",
+                                    "9999999999999999", "-9999999999999999", "10000000000000000", "-10000000000000000",
+                                    "99999999", "100000000", "12345678", "123456789", "\"42\"", "\"-42\"", "\"12345678901234567\""};
+    addLimits<int32_t>(values);
+    addLimits<int64_t>(values);
+    addLimits<uint64_t>(values);
+
+    // every length from 1 to 20 digits, the SWAR path takes up to 16, from_chars() the longer ones
+    std::mt19937_64 random{30};
+    for (size_t length = 1; length <= 20; ++length) {
+        for (int i = 0; i < 200; ++i) {
+            std::string digits;
+            for (size_t d = 0; d < length; ++d) digits += (char) ('0' + random() % 10);
+            values.push_back(digits);
+            values.push_back('-' + digits);
+        }
+    }
+
+    checkValues(values, [](const auto &row, const std::string &text) {
+        checkInteger<int64_t>(row, text);
+        checkInteger<int32_t>(row, text);
+        checkInteger<uint64_t>(row, text);
+        checkInteger<uint16_t>(row, text);
+    });
+}
+
+template<class T, class Row>
+static void checkFloat(const Row &row, const std::string &text) {
+    T expected{};
+    if (!reference(text, expected)) return;
+
+    CHECK(row.template as<T>(0) == expected);
+    CHECK(row.template as<T>(1) == expected);
+    CHECK(parseColumn<T>(text) == expected);
+}
+
+static void checkFloats() {
+    std::vector<std::string> values{"0", "-0", "0.0", "1", "-1", "0.1", "0.3", "-2.5", ".5", "12.", "-0.", "007.25",
+                                    // 2^24 (float) and 2^53 (double) and the numbers after them, past which from_chars() takes over
+                                    "16777216", "16777217", "1677721.7", "1677721.8", "9007199254740992", "9007199254740993",
+                                    "900719925474099.3", "0.9007199254740993", "1234567890123456789", "12345678901234567890",
+                                    // more fraction digits than exact powers of 10
+                                    "0.12345678901", "0.00000000000000000000001", "1.00000000000000000000000",
+                                    // exponents, and values that are not decimal numbers
+                                    "1e5", "1E5", "1.5e-3", "-2.5E+10", "1e308", "1e-320", "1e400", "inf", "-inf", "1.2.3", "1-2", "",
+                                    // quoted numbers
+                                    "\"1.5\"", "\"-3\"", "\"2e10\"", "\"0.1\""};
+
+    // up to 19 significant digits, with the point anywhere in them
+    std::mt19937_64 random{31};
+    for (size_t length = 1; length <= 20; ++length) {
+        for (int i = 0; i < 200; ++i) {
+            std::string digits;
+            for (size_t d = 0; d < length; ++d) digits += (char) ('0' + random() % 10);
+            digits.insert(random() % (length + 1), ".");
+            values.push_back(digits);
+            values.push_back('-' + digits);
+        }
+    }
+
+    checkValues(values, [](const auto &row, const std::string &text) {
+        checkFloat<double>(row, text);
+        checkFloat<float>(row, text);
+    });
+}
+
+// a timestamp with its value, from timegm()
+struct TimestampText {
+    std::string text;
+    int64_t nanoseconds;
+};
+
+static std::string twoDigits(unsigned value) {
+    return {(char) ('0' + value / 10), (char) ('0' + value % 10)};
+}
+
+static unsigned daysInMonth(int year, unsigned month) {
+    static constexpr unsigned DAYS[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    const bool leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+    return month == 2 && leap ? 29 : DAYS[month - 1];
+}
+
+// any separator, 0 to 9 digits of fractional seconds, and no offset, Z or +-hh:mm
+static TimestampText randomTimestamp(std::mt19937_64 &random) {
+    tm time{};
+    const int year = 1678 + (int) (random() % (2261 - 1678 + 1));
+    time.tm_year = year - 1900;
+    time.tm_mon = (int) (random() % 12);
+    time.tm_mday = 1 + (int) (random() % daysInMonth(year, time.tm_mon + 1));
+    time.tm_hour = (int) (random() % 24);
+    time.tm_min = (int) (random() % 60);
+    time.tm_sec = (int) (random() % 60);
+
+    std::string text = std::to_string(year) + '-' + twoDigits(time.tm_mon + 1) + '-' + twoDigits(time.tm_mday) + (random() % 2 ? 'T' : ' ') +
+                       twoDigits(time.tm_hour) + ':' + twoDigits(time.tm_min) + ':' + twoDigits(time.tm_sec);
+    int64_t nanoseconds = (int64_t) timegm(&time) * 1000000000;
+
+    const unsigned fraction_digits = random() % 10;
+    if (fraction_digits) {
+        text += '.';
+        int64_t fraction = 0;
+        for (unsigned i = 0; i < 9; ++i) {
+            const unsigned digit = i < fraction_digits ? random() % 10 : 0;
+            if (i < fraction_digits) text += (char) ('0' + digit);
+            fraction = 10 * fraction + digit;
+        }
+        nanoseconds += fraction;
+    }
+
+    switch (random() % 3) {
+        case 0:
+            break;
+        case 1:
+            text += 'Z';
+            break;
+        default:
+            // the time is ahead of UTC by a positive offset
+            const bool negative = random() % 2;
+            const unsigned hours = random() % 15, minutes = random() % 60;
+            text += (negative ? '-' : '+') + twoDigits(hours) + ':' + twoDigits(minutes);
+            nanoseconds -= (negative ? -1 : 1) * (int64_t) (hours * 3600 + minutes * 60) * 1000000000;
+    }
+    return TimestampText{text, nanoseconds};
+}
+
+static void checkTimestamps() {
+    std::vector<TimestampText> timestamps{{"1970-01-01T00:00:00", 0},
+                                          {"1970-01-01T00:00:00Z", 0},
+                                          {"1970-01-01T01:00:00+01:00", 0},
+                                          {"1969-12-31T19:00:00-05:00", 0},
+                                          {"1969-12-31 23:59:59.999999999", -1},
+                                          {"1969-12-31T23:59:59.5Z", -500000000},
+                                          {"2000-02-29T12:00:00.000000001", 951825600000000001},
+                                          {"1678-01-01T00:00:00", -9214560000000000000},
+                                          {"2261-12-31T23:59:59.999999999Z", 9214646399999999999}};
+    std::mt19937_64 random{32};
+    for (int i = 0; i < 20000; ++i) timestamps.push_back(randomTimestamp(random));
+
+    std::vector<std::string> values;
+    for (const TimestampText &timestamp : timestamps) values.push_back(timestamp.text);
+    values.emplace_back(); // std::optional
+
+    size_t index = 0;
+    checkValues(values, [&](const auto &row, const std::string &text) {
+        if (text.empty()) {
+            CHECK(!row.template as<std::optional<Timestamp>>(0));
+            return;
+        }
+        const int64_t expected = timestamps[index++].nanoseconds;
+        CHECK(row.template as<Timestamp>(0).nanoseconds == expected);
+        CHECK(row.template as<Timestamp>(1).nanoseconds == expected);
+        CHECK(row.template as<std::optional<Timestamp>>(1)->nanoseconds == expected);
+        CHECK(parseColumn<Timestamp>(text).nanoseconds == expected);
+    });
+}
+
+static void checkDates() {
+    std::vector<Date> dates{{1970, 1, 1}, {1969, 12, 31}, {1, 1, 1}, {9999, 12, 31}, {2000, 2, 29}, {1600, 2, 29}};
+    std::mt19937_64 random{33};
+    for (int i = 0; i < 5000; ++i) {
+        const int year = (int) (random() % 10000);
+        const auto month = (unsigned) (1 + random() % 12);
+        dates.push_back(Date{year, month, (unsigned) (1 + random() % daysInMonth(year, month))});
+    }
+
+    std::vector<std::string> values;
+    for (const Date &date : dates) {
+        std::string year = std::to_string(date.year);
+        values.push_back(std::string(4 - year.size(), '0') + year + '-' + twoDigits(date.month) + '-' + twoDigits(date.day));
+    }
+
+    size_t index = 0;
+    checkValues(values, [&](const auto &row, const std::string &text) {
+        const Date &expected = dates[index++];
+        CHECK(row.template as<Date>(0) == expected);
+        CHECK(row.template as<Date>(1) == expected);
+        CHECK(parseColumn<Date>(text) == expected);
+    });
+}
+
+int main() {
+    checkIntegers();
+    checkFloats();
+    checkTimestamps();
+    checkDates();
+
+    return testResult("columnTypesTest");
+}
@@ -0,0 +1,125 @@
+#include <functional>
+#include <unordered_set>
+
+#include "testUtils.hpp"
+#include "../lib/fastCSV/fastCSV.hpp"
+
+// FastCSV::setFilter(): for loops and nextBlock() visit the rows of the reference that match the filter, with every kernel and with a projection
+// the filter is set after the header, which is always visited
+
+using Predicate = std::function<bool(const ReferenceRow &)>;
+
+// the header, and the other rows that match
+static std::vector<const ReferenceRow *> matching(const std::vector<ReferenceRow> &expected, const Predicate &predicate) {
+    std::vector<const ReferenceRow *> rows;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        if (i == 0 || predicate(expected[i])) rows.push_back(&expected[i]);
+    }
+    return rows;
+}
+
+// with a projection, the last column and the first one, in that order
+static void checkRow(std::string_view raw, const std::function<std::string_view(int)> &column, const ReferenceRow &reference, bool projected) {
+    CHECK(raw == reference.raw);
+    if (projected) {
+        CHECK(column(0) == reference.columns.back());
+        CHECK(column(1) == reference.columns[0]);
+    }
+}
+
+static void checkFilter(const char *path, const std::vector<ReferenceRow> &expected, const Filter &filter, const Predicate &predicate) {
+    const std::vector<const ReferenceRow *> rows = matching(expected, predicate);
+    const int last = (int) expected[0].columns.size() - 1;
+
+    for (bool projected : {false, true}) {
+        std::unique_ptr<FastCSV<DYNAMIC_COLUMNS>> csv;
+        if (projected) csv.reset(new FastCSV<DYNAMIC_COLUMNS>(path, Projection{last, 0}));
+        else csv.reset(new FastCSV<DYNAMIC_COLUMNS>(path));
+        csv->setFilter(filter);
+
+        size_t count = 0;
+        for (const auto &row : *csv) {
+            CHECK(count < rows.size());
+            if (count >= rows.size()) break;
+            checkRow(row.getRaw(), [&](int i) { return row[i]; }, *rows[count++], projected);
+        }
+        CHECK(count == rows.size());
+
+        if (projected) csv.reset(new FastCSV<DYNAMIC_COLUMNS>(path, Projection{last, 0}));
+        else csv.reset(new FastCSV<DYNAMIC_COLUMNS>(path));
+        csv->setFilter(filter);
+
+        RowBlock block{64};
+        count = 0;
+        while (csv->nextBlock(block)) {
+            for (size_t r = 0; r < block.size() && count < rows.size(); ++r) {
+                checkRow(block.getRaw(r), [&](int i) { return block.get(r, i); }, *rows[count++], projected);
+            }
+        }
+        CHECK(count == rows.size());
+    }
+}
+
+static void checkFile(const std::string &data, bool quoted_newlines) {
+    TempFile file{data};
+    const std::vector<ReferenceRow> expected = referenceParse(data);
+
+    const SimdLevel detected = detectSimdLevel();
+    for (int level = (int) SimdLevel::SCALAR; level <= (int) detected; ++level) {
+        simd_level = (SimdLevel) level;
+
+        const std::string quoted = "\"a \"\"quoted\"\" word\"";
+        checkFilter(file.c_str(), expected, Filter::equals(2, quoted), [&](const ReferenceRow &row) { return row.columns[2] == quoted; });
+        checkFilter(file.c_str(), expected, Filter::equals(-1, ""), [](const ReferenceRow &row) { return row.columns.back().empty(); });
+        checkFilter(file.c_str(), expected, Filter::startsWith(0, "12"), [](const ReferenceRow &row) { return row.columns[0].rfind("12", 0) == 0; });
+        checkFilter(file.c_str(), expected, Filter::contains(1, "qq,x"), [](const ReferenceRow &row) { return row.columns[1].find("qq,x") != std::string::npos; });
+        checkFilter(file.c_str(), expected, Filter::rowContains("zzzz"), [](const ReferenceRow &row) { return row.raw.find("zzzz") != std::string::npos; });
+        checkFilter(file.c_str(), expected, Filter::rowContains("no such text"), [](const ReferenceRow &) { return false; });
+
+        // grep finds rows from the newlines around a match, so its files have no quoted newlines
+        if (!quoted_newlines) {
+            checkFilter(file.c_str(), expected, Filter::grep("7,\""), [](const ReferenceRow &row) { return row.raw.find("7,\"") != std::string::npos; });
+            checkFilter(file.c_str(), expected, Filter::grep("kkkkkkkk"), [](const ReferenceRow &row) { return row.raw.find("kkkkkkkk") != std::string::npos; });
+        }
+
+        // thousands of keys, and needles of several lengths overlapping each other, one of them a prefix of another
+        std::vector<std::string> numbers;
+        for (size_t n = 0; n < expected.size() * 2; n += 37) numbers.push_back(std::to_string(n));
+        const std::vector<std::string_view> keys{numbers.begin(), numbers.end()};
+        const std::unordered_set<std::string_view> key_set{keys.begin(), keys.end()};
+        checkFilter(file.c_str(), expected, Filter::anyOf(0, keys), [&](const ReferenceRow &row) { return key_set.count(row.columns[0]) != 0; });
+        const std::vector<std::string_view> words{"", "one line", "\"\"\"\"", quoted};
+        checkFilter(file.c_str(), expected, Filter::anyOf(-1, words), [&](const ReferenceRow &row) {
+            return std::find(words.begin(), words.end(), row.columns.back()) != words.end();
+        });
+
+        const std::vector<std::string_view> needles{"qqqqq", "xxxxxxxxxxxxx", "\"\"quo", "\"\"quoted\"\" word", "lines", "ab", "999"};
+        const auto containsAny = [&](const std::string &text) {
+            return std::any_of(needles.begin(), needles.end(), [&](std::string_view needle) { return text.find(needle) != std::string::npos; });
+        };
+        checkFilter(file.c_str(), expected, Filter::containsAny(1, needles), [&](const ReferenceRow &row) { return containsAny(row.columns[1]); });
+        checkFilter(file.c_str(), expected, Filter::containsAny(-1, needles), [&](const ReferenceRow &row) { return containsAny(row.columns.back()); });
+        checkFilter(file.c_str(), expected, Filter::rowContainsAny(needles), [&](const ReferenceRow &row) { return containsAny(row.raw); });
+
+        // a number before a quoted column
+        std::vector<std::string> prefixes;
+        for (size_t n = 0; n < 64; ++n) prefixes.push_back(std::to_string(n * 1009) + ",\"");
+        const std::vector<std::string_view> row_needles{prefixes.begin(), prefixes.end()};
+        checkFilter(file.c_str(), expected, Filter::rowContainsAny(row_needles), [&](const ReferenceRow &row) {
+            return std::any_of(row_needles.begin(), row_needles.end(), [&](std::string_view needle) { return row.raw.find(needle) != std::string::npos; });
+        });
+    }
+    simd_level = detected;
+}
+
+int main() {
+    // quoted newlines, and columns longer than the 16KB index window
+    checkFile(randomCsv(20, 60000, CsvShape{5, true, 499}), true);
+
+    // rows crossing the 1MB buffer, and no newline at the end
+    std::string data = randomCsv(21, 100000, CsvShape{4, false});
+    data.pop_back();
+    checkFile(data, false);
+
+    return testResult("filterTest");
+}
@@ -0,0 +1,195 @@
+#include <charconv>
+
+#include "testUtils.hpp"
+#include "../lib/fastCSV/fastCSV.hpp"
+#include "../lib/fastCSV/typedFastCSV.hpp"
+
+// the two stage parser returns the rows and columns of the reference, with every kernel up to the one of this CPU
+// through for loops, a projection and nextBlock(), with a column table that grows or one of max_columns
+
+template<class CSVDialect, int max_columns>
+static void checkRows(const char *path, const std::vector<ReferenceRow> &expected) {
+    FastCSV<max_columns, RawReadBuffer, CSVDialect> csv(path);
+
+    size_t count = 0;
+    for (const auto &row : csv) {
+        CHECK(count < expected.size());
+        if (count >= expected.size()) break;
+
+        const ReferenceRow &reference = expected[count++];
+        CHECK(row.getRaw() == reference.raw);
+        CHECK(csv.getColumns() == (int) reference.columns.size());
+        if (csv.getColumns() != (int) reference.columns.size()) break;
+        for (int i = 0; i < csv.getColumns(); ++i) CHECK(row[i] == reference.columns[i]);
+    }
+    CHECK(count == expected.size());
+}
+
+// the last column and the first one, in that order
+template<class CSVDialect, int max_columns>
+static void checkProjection(const char *path, const std::vector<ReferenceRow> &expected) {
+    const int last = (int) expected[0].columns.size() - 1;
+    FastCSV<max_columns, RawReadBuffer, CSVDialect> csv(path, Projection{last, 0});
+
+    size_t count = 0;
+    for (const auto &row : csv) {
+        CHECK(count < expected.size());
+        if (count >= expected.size()) break;
+
+        const ReferenceRow &reference = expected[count++];
+        CHECK(row.getRaw() == reference.raw);
+        CHECK(row[0] == reference.columns[last]);
+        CHECK(row[1] == reference.columns[0]);
+    }
+    CHECK(count == expected.size());
+}
+
+// blocks of a few rows, so that blocks end at windows and buffer ends too
+template<class CSVDialect, int max_columns>
+static void checkBlocks(const char *path, const std::vector<ReferenceRow> &expected) {
+    FastCSV<max_columns, RawReadBuffer, CSVDialect> csv(path);
+    RowBlock block{37};
+
+    size_t count = 0;
+    while (csv.nextBlock(block)) {
+        CHECK(block.size() > 0);
+        for (size_t r = 0; r < block.size() && count < expected.size(); ++r) {
+            const ReferenceRow &reference = expected[count++];
+            CHECK(block.getRaw(r) == reference.raw);
+            for (int i = 0; i < block.getColumns() && i < (int) reference.columns.size(); ++i) CHECK(block.get(r, i) == reference.columns[i]);
+        }
+    }
+    CHECK(count == expected.size());
+}
+
+// a fixed max_columns must be at least 3, for the projection of 2 columns
+template<class CSVDialect = Dialect<>, int max_columns = DYNAMIC_COLUMNS>
+static void checkFile(const std::string &data) {
+    TempFile file{data};
+    const std::vector<ReferenceRow> expected = referenceParse(data, CSVDialect::DELIMITER, CSVDialect::QUOTE, CSVDialect::CRLF_ENDINGS, CSVDialect::ESCAPE);
+
+    const SimdLevel detected = detectSimdLevel();
+    for (int level = (int) SimdLevel::SCALAR; level <= (int) detected; ++level) {
+        simd_level = (SimdLevel) level;
+        checkRows<CSVDialect, max_columns>(file.c_str(), expected);
+        if (!expected.empty()) checkProjection<CSVDialect, max_columns>(file.c_str(), expected);
+        checkBlocks<CSVDialect, max_columns>(file.c_str(), expected);
+    }
+    simd_level = detected;
+}
+
+// the number in a column of the reference, without its quotes
+template<class T>
+static T referenceNumber(std::string_view text) {
+    if (text.size() >= 2 && text.front() == '"') text = text.substr(1, text.size() - 2);
+    T value{};
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    CHECK(error == std::errc{} && end == text.data() + text.size());
+    return value;
+}
+
+// id,price,name,count,day: numbers that are sometimes quoted, a string with quoted delimiters and newlines, empty counts and dates
+static std::string typedCsv(uint64_t seed, size_t rows) {
+    std::mt19937_64 random{seed};
+    std::string data = "id,price,name,count,day\n";
+    for (size_t r = 0; r < rows; ++r) {
+        const std::string price = std::to_string(random() % 100000) + '.' + std::to_string(random() % 100);
+        data += std::to_string((int64_t) r - 1000) + ',' + (random() % 4 ? price : '"' + price + '"') + ',';
+        data += random() % 2 ? std::string(1 + random() % 20, (char) ('a' + random() % 26)) : "\"a, \"\"b\"\"\nc\"";
+        data += ',' + (random() % 3 ? std::to_string(random() % 1000) : "") + ',';
+        data += std::to_string(1900 + random() % 200) + "-0" + std::to_string(1 + random() % 9) + '-' + std::to_string(10 + random() % 19) + '\n';
+    }
+    return data;
+}
+
+// TypedFastCSV converts the columns of the reference rows, those of the file and those of a projection by name
+static void checkTyped(const std::string &data) {
+    TempFile file{data};
+    const std::vector<ReferenceRow> expected = referenceParse(data);
+
+    size_t count = 1; // after the header
+    TypedFastCSV<Schema<int64_t, double, std::string_view, std::optional<int64_t>, Date>> csv(file.c_str());
+    for (const auto &[id, price, name, quantity, day] : csv) {
+        CHECK(count < expected.size());
+        if (count >= expected.size()) break;
+
+        const std::vector<std::string> &columns = expected[count++].columns;
+        CHECK(id == referenceNumber<int64_t>(columns[0]));
+        CHECK(price == referenceNumber<double>(columns[1]));
+        CHECK(name == columns[2]);
+        CHECK(quantity == (columns[3].empty() ? std::nullopt : std::optional<int64_t>{referenceNumber<int64_t>(columns[3])}));
+        const Date reference{referenceNumber<int>(columns[4].substr(0, 4)), referenceNumber<unsigned>(columns[4].substr(5, 2)),
+                             referenceNumber<unsigned>(columns[4].substr(8, 2))};
+        CHECK(day == reference);
+    }
+    CHECK(count == expected.size());
+
+    count = 1;
+    TypedFastCSV<Schema<double, int64_t>> projected(file.c_str(), Projection{"price", "id"});
+    for (const auto &[price, id] : projected) {
+        CHECK(count < expected.size());
+        if (count >= expected.size()) break;
+
+        const std::vector<std::string> &columns = expected[count++].columns;
+        CHECK(price == referenceNumber<double>(columns[1]));
+        CHECK(id == referenceNumber<int64_t>(columns[0]));
+    }
+    CHECK(count == expected.size());
+}
+
+// every newline as \r\n, in quoted columns too
+static std::string crlf(const std::string &data) {
+    std::string result;
+    for (char c : data) {
+        if (c == '\n') result += '\r';
+        result += c;
+    }
+    return result;
+}
+
+// rows of 5 columns with a backslash as the last byte of a 64 byte block and of a 16KB index window, the byte it escapes starting the next one:
+// a delimiter, a quote, a newline, a quote inside a quoted column, and an escaped backslash before a delimiter
+static std::string escapesAtBlockEnds() {
+    std::string data;
+    for (size_t block : {64, 16384}) {
+        for (const std::string escaped : {",", "\"", "\n", "\"q\"", "\\"}) {
+            const bool quoted = escaped.size() == 3;
+            std::string row = std::to_string(data.size()) + ',' + (quoted ? "\"" : "");
+            row += std::string(block - 1 - (data.size() + row.size()) % block, 'p') + '\\' + escaped;
+            data += row + ",c,d,e\n";
+        }
+    }
+    return data;
+}
+
+int main() {
+    // quoted newlines, and columns longer than the 16KB index window
+    const std::string data = randomCsv(10, 60000, CsvShape{5, true, 503});
+    checkFile(data);
+    checkFile<Dialect<>, 5>(data); // exactly the columns of the file
+    checkFile<Dialect<>, 16>(data);
+    checkFile<Dialect<',', CRLF>>(crlf(data));
+    checkFile<Dialect<'\t'>>(randomCsv(11, 20000, CsvShape{4, true, 211}, '\t'));
+    checkFile<Dialect<',', LF, '"', '\\'>>(escapesAtBlockEnds() + randomCsv(15, 60000, CsvShape{5, true, 509, '\\'}));
+
+    // a row longer than the 1MB buffer, and rows crossing it
+    checkFile("a,b\n1,\"" + std::string(3U << 20U, 'x') + ",\n\"\n2,3\n" + randomCsv(12, 100000, CsvShape{2, true}));
+
+    // every row count of a small file, with and without the last newline, so the data ends at many positions of its last 64 byte block
+    const std::string small = randomCsv(13, 40, CsvShape{3, true});
+    for (const ReferenceRow &row : referenceParse(small)) {
+        const size_t end = row.offset + row.raw.size();
+        checkFile(small.substr(0, end));
+        checkFile(small.substr(0, end + 1));
+        checkFile<Dialect<>, 3>(small.substr(0, end));
+    }
+
+    // a single column, an empty row, no rows
+    checkFile("a\nb\n\nc");
+    checkFile("");
+
+    checkTyped(typedCsv(14, 100000));
+    checkTyped("id,price,name,count,day\n");
+
+    return testResult("parserTest");
+}
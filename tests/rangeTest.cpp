@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#include "testUtils.hpp"
+#include "../lib/fastCSV/fastCSV.hpp"
+#include "../lib/fastCSV/mmapReadBuffer.hpp"
+#include "../lib/fastCSV/gzipReadBuffer.hpp"
+#include "../lib/fastCSV/parallelFastCSV.hpp"
+
+// the byte ranges of MmapReadBuffer and GzipReadBuffer: consecutive ranges visit every row of the file once, in order
+// a range starts at the row after the newline before its begin, and ends with the row crossing its end
+
+// the start of the range for a range position, as MmapReadBuffer snaps it
+static size_t snap(const std::string &data, size_t position) {
+    if (position == 0) return 0;
+    const size_t newline = data.find('\n', position - 1);
+    return newline == std::string::npos ? data.size() : newline + 1;
+}
+
+// the rows of every range, when the file is split into ranges of the same size
+template<class ReadBuffer>
+static void checkRanges(const char *path, const std::string &data, const std::vector<ReferenceRow> &expected, int ranges) {
+    const size_t size = data.size();
+    size_t next = 0; // index of the next expected row
+    for (int i = 0; i < ranges; ++i) {
+        const size_t begin = size * i / ranges, end = size * (i + 1) / ranges;
+        FastCSV<DYNAMIC_COLUMNS, ReadBuffer> csv(path, begin, end);
+
+        // the rows starting in the snapped range
+        const size_t range_begin = snap(data, begin), range_end = snap(data, end);
+        size_t count = 0, expected_count = 0;
+        for (const ReferenceRow &row : expected) expected_count += row.offset >= range_begin && row.offset < range_end;
+
+        for (const auto &row : csv) {
+            ++count;
+            CHECK(next < expected.size());
+            if (next >= expected.size()) break;
+            CHECK(row.getRaw() == expected[next].raw);
+            ++next;
+        }
+        CHECK(count == expected_count);
+        if (count != expected_count) fprintf(stderr, "range %d of %d: %zu rows, expected %zu\n", i, ranges, count, expected_count);
+    }
+    CHECK(next == expected.size());
+}
+
+// parallelForEach() and parallelReduce() visit every row once, on any number of threads (more threads than rows too)
+// parallelReduce() merges the results in file order
+template<class ReadBuffer>
+static void checkParallel(const char *path, const std::vector<ReferenceRow> &expected) {
+    for (bool skip_header : {true, false}) {
+        std::vector<std::string> rows;
+        for (size_t i = skip_header ? 1 : 0; i < expected.size(); ++i) rows.push_back(expected[i].raw);
+
+        for (unsigned threads : {1, 3, 8, 33}) {
+            std::mutex mutex;
+            std::vector<std::string> visited;
+            parallelForEach<DYNAMIC_COLUMNS, ReadBuffer>(path, [&](const auto &row) {
+                std::lock_guard lock{mutex};
+                visited.emplace_back(row.getRaw());
+            }, skip_header, threads);
+
+            std::sort(visited.begin(), visited.end());
+            std::vector<std::string> sorted = rows;
+            std::sort(sorted.begin(), sorted.end());
+            CHECK(visited == sorted);
+
+            const auto reduced = parallelReduce<DYNAMIC_COLUMNS, ReadBuffer>(path, std::vector<std::string>{},
+                    [](std::vector<std::string> &result, const auto &row) { result.emplace_back(row.getRaw()); },
+                    [](std::vector<std::string> &result, std::vector<std::string> &&other) { result.insert(result.end(), other.begin(), other.end()); },
+                    skip_header, threads);
+            CHECK(reduced == rows);
+        }
+    }
+}
+
+// splits the file into each number of ranges
+template<class ReadBuffer = MmapReadBuffer>
+static void checkRanges(const std::string &data, std::initializer_list<int> range_counts) {
+    TempFile file{data, std::is_same_v<ReadBuffer, GzipReadBuffer> ? ".csv.gz" : ".csv"};
+    if constexpr (std::is_same_v<ReadBuffer, GzipReadBuffer>) writeGzip(file.c_str(), data);
+
+    const std::vector<ReferenceRow> expected = referenceParse(data);
+    const size_t size = ReadBuffer::dataSize(file.c_str());
+    CHECK(size == data.size());
+
+    for (int ranges : range_counts) checkRanges<ReadBuffer>(file.c_str(), data, expected, ranges);
+    if constexpr (std::is_same_v<ReadBuffer, MmapReadBuffer>) checkParallel<ReadBuffer>(file.c_str(), expected);
+}
+
+int main() {
+    // the byte after the end of every range but the last is the first digit of a row, not a newline
+    // so a row end indexed past the end of a range would start the next range a second time
+    const std::string data = randomCsv(1, 200000, CsvShape{3, false});
+    checkRanges(data, {1, 2, 3, 8, 33});
+
+    // ranges ending in the last partial 64 byte block of the data, and empty ranges
+    const std::string small = randomCsv(2, 40, CsvShape{3, false});
+    checkRanges(small, {5, 64, 500});
+
+    // a file without a newline at its end
+    checkRanges("a,b\n1,2\n3,4", {2, 3});
+
+    // gzip ranges resume inflating from the GzipIndex points (every 8MB of inflated data) before them
+    const std::string large = randomCsv(3, 600000, CsvShape{4, false});
+    CHECK(large.size() > 2 * GzipIndex::SPAN);
+    checkRanges<GzipReadBuffer>(large, {1, 3, 7});
+
+    return testResult("rangeTest");
+}
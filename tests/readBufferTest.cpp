@@ -0,0 +1,82 @@
+#include "testUtils.hpp"
+#include "../lib/fastCSV/fastCSV.hpp"
+#include "../lib/fastCSV/mmapReadBuffer.hpp"
+#include "../lib/fastCSV/prefetchReadBuffer.hpp"
+#include "../lib/fastCSV/ioUringReadBuffer.hpp"
+#include "../lib/fastCSV/gzipReadBuffer.hpp"
+#include "../lib/fastCSV/pipelinedGzipReadBuffer.hpp"
+#include "../lib/fastCSV/parallelGzipReadBuffer.hpp"
+#include "../lib/fastCSV/speculativeGzipReadBuffer.hpp"
+
+// every ReadBuffer returns the rows of the reference, for rows crossing its buffers and rows longer than them
+
+template<class ReadBuffer>
+static void checkRows(const char *path, const std::vector<ReferenceRow> &expected) {
+    FastCSV<DYNAMIC_COLUMNS, ReadBuffer> csv(path);
+
+    size_t count = 0;
+    for (const auto &row : csv) {
+        CHECK(count < expected.size());
+        if (count >= expected.size()) break;
+        CHECK(row.getRaw() == expected[count].raw);
+        ++count;
+    }
+    CHECK(count == expected.size());
+}
+
+static void checkFile(const std::string &data) {
+    TempFile file{data};
+    const std::vector<ReferenceRow> expected = referenceParse(data);
+
+    checkRows<RawReadBuffer>(file.c_str(), expected);
+    checkRows<MmapReadBuffer>(file.c_str(), expected);
+    checkRows<PrefetchReadBuffer>(file.c_str(), expected);
+    checkRows<IoUringReadBuffer<>>(file.c_str(), expected);
+
+    // one gzip member, and appended files of several members (as ParallelGzipReadBuffer inflates them on several threads)
+    for (size_t members : {1, 3, 64}) {
+        TempFile gzip{"", ".csv.gz"};
+        writeGzip(gzip.c_str(), data, members);
+
+        checkRows<GzipReadBuffer>(gzip.c_str(), expected);
+        checkRows<PipelinedGzipReadBuffer>(gzip.c_str(), expected);
+        checkRows<ParallelGzipReadBuffer>(gzip.c_str(), expected);
+        checkRows<SpeculativeGzipReadBuffer>(gzip.c_str(), expected);
+    }
+}
+
+// the reads after a file was truncated complete with 0 bytes, or with the bytes before its new end again, its rows then end there
+// instead of waiting for the missing data (the 4 reads in flight when it is truncated are done before the new end)
+static void checkTruncated(const std::string &data) {
+    TempFile file{data};
+    const std::vector<ReferenceRow> expected = referenceParse(data);
+    const size_t rows = expected.size() / 3;
+
+    FastCSV<DYNAMIC_COLUMNS, IoUringReadBuffer<>> csv(file.c_str());
+    CHECK(truncate(file.c_str(), (off_t) expected[rows].offset) == 0);
+
+    size_t count = 0;
+    for (const auto &row : csv) {
+        CHECK(count < rows);
+        if (count >= rows) break;
+        CHECK(row.getRaw() == expected[count++].raw);
+    }
+    CHECK(count == rows);
+}
+
+int main() {
+    // several MB, with quoted newlines and columns longer than the 16KB index window
+    checkFile(randomCsv(8, 150000, CsvShape{5, true, 301}));
+
+    // a row longer than the 1MB buffers, which are then grown
+    checkFile("a,b\n1,\"" + std::string(3U << 20U, 'x') + "\"\n2,3\n");
+
+    // no newline at the end, no rows
+    checkFile("a,b\n1,2");
+    checkFile("");
+
+    // more than 3 times the data of the reads in flight
+    checkTruncated(randomCsv(9, 400000, CsvShape{5, true}));
+
+    return testResult("readBufferTest");
+}
@@ -0,0 +1,82 @@
+#include <fstream>
+#include <iterator>
+
+#include "testUtils.hpp"
+#include "../lib/fastCSV/rowIndex.hpp"
+
+// FastCSV::seekToRow() with a RowIndex: the row it stops at, and the rows after it, are those of the reference
+
+template<class ReadBuffer>
+static void checkSeeks(const char *path, const RowIndex &index, const std::vector<ReferenceRow> &expected, bool projected) {
+    std::unique_ptr<FastCSV<DYNAMIC_COLUMNS, ReadBuffer>> csv;
+    if (projected) csv.reset(new FastCSV<DYNAMIC_COLUMNS, ReadBuffer>(path, Projection{2, 0}));
+    else csv.reset(new FastCSV<DYNAMIC_COLUMNS, ReadBuffer>(path));
+
+    std::mt19937_64 random{7};
+    for (int i = 0; i < 500; ++i) {
+        // indexed rows, the rows around them, any row, and past the end
+        uint64_t n = random() % (expected.size() + 3);
+        if (i % 4 == 0) n = random() % (expected.size() / RowIndex::EVERY + 1) * RowIndex::EVERY + random() % 3 - 1;
+        if (n == UINT64_MAX) n = 0;
+
+        csv->seekToRow(index, n);
+        for (uint64_t row = n; row < n + 3; ++row, csv->nextRow()) {
+            CHECK(csv->finished() == (row >= expected.size()));
+            if (csv->finished() || row >= expected.size()) break;
+
+            const ReferenceRow &reference = expected[row];
+            if (projected) {
+                CHECK(csv->getRow()[0] == reference.columns[2]);
+                CHECK(csv->getRow()[1] == reference.columns[0]);
+            } else {
+                CHECK(csv->getRow().getRaw() == reference.raw);
+            }
+        }
+    }
+}
+
+static void checkFile(const std::string &data) {
+    TempFile file{data};
+    const std::vector<ReferenceRow> expected = referenceParse(data);
+
+    const auto index = RowIndex::open(file.c_str());
+    CHECK(index->rows == expected.size());
+    CHECK(index->offsets.size() == (expected.size() + RowIndex::EVERY - 1) / RowIndex::EVERY);
+    for (size_t i = 0; i < index->offsets.size(); ++i) CHECK(index->offsets[i] == expected[i * RowIndex::EVERY].offset);
+
+    for (bool projected : {false, true}) {
+        if (projected && (expected.empty() || expected[0].columns.size() < 3)) continue;
+        checkSeeks<RawReadBuffer>(file.c_str(), *index, expected, projected);
+        checkSeeks<MmapReadBuffer>(file.c_str(), *index, expected, projected);
+    }
+
+    // the sidecar file is loaded for the same file (a hard link, which has the same size and mtime), instead of being built again
+    const std::string link_path = std::string{file.c_str()} + ".link";
+    CHECK(link(file.c_str(), link_path.c_str()) == 0);
+    {
+        std::ifstream sidecar{std::string{file.c_str()} + ".fcrows", std::ios::binary};
+        std::ofstream copy{link_path + ".fcrows", std::ios::binary};
+        copy << sidecar.rdbuf();
+    }
+
+    const auto loaded = RowIndex::open(link_path.c_str());
+    CHECK(loaded->rows == index->rows && loaded->offsets == index->offsets);
+
+    unlink(link_path.c_str());
+    unlink((link_path + ".fcrows").c_str());
+}
+
+int main() {
+    // quoted newlines (which do not start rows), and columns longer than the 16KB index window
+    checkFile(randomCsv(4, 50000, CsvShape{5, true, 997}));
+
+    // rows crossing the 1MB buffer of RawReadBuffer, which then reads them again from the file
+    checkFile(randomCsv(5, 300000, CsvShape{3, true}));
+
+    // fewer rows than EVERY, no newline at the end, no rows
+    checkFile(randomCsv(6, 100, CsvShape{4, true}));
+    checkFile("a,b,c\n1,2,3\n4,5,6");
+    checkFile("");
+
+    return testResult("seekTest");
+}
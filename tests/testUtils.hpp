@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unistd.h>
+
+#include "../lib/zlib/zlib.h"
+
+// the tests compare FastCSV with a plain scalar parser of the same data, they are run by ctest
+// they report failures with CHECK instead of assert(), so that they also run with NDEBUG
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            if (failures++ < 20) fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+        } \
+    } while (false)
+
+// exit code of main()
+inline int testResult(const char *name) {
+    if (failures) fprintf(stderr, "%s: %d failures\n", name, failures);
+    else printf("%s: ok\n", name);
+    return failures != 0;
+}
+
+// a file with the given data, deleted with its sidecar files at the end of the test
+class TempFile {
+public:
+    explicit TempFile(const std::string &data, const char *suffix = ".csv") {
+        path = std::string{"/tmp/fastCSV_test_XXXXXX"} + suffix;
+        const int fd = mkstemps(path.data(), (int) strlen(suffix));
+        if (fd == -1 || write(fd, data.data(), data.size()) != (ssize_t) data.size() || close(fd) != 0) {
+            fprintf(stderr, "cannot write %s\n", path.c_str());
+            exit(2);
+        }
+    }
+    TempFile(const TempFile &) = delete;
+
+    ~TempFile() {
+        unlink(path.c_str());
+        unlink((path + ".fcrows").c_str());
+        unlink((path + ".fcidx").c_str());
+    }
+
+    [[nodiscard]] const char *c_str() const { return path.c_str(); }
+
+private:
+    std::string path;
+};
+
+// writes data as a gzip file, with several deflate blocks, and split into members (an appended file) if members > 1
+inline void writeGzip(const char *path, const std::string &data, size_t members = 1) {
+    for (size_t member = 0; member < members; ++member) {
+        gzFile file = gzopen(path, member ? "ab1" : "wb1");
+        const size_t begin = data.size() * member / members, end = data.size() * (member + 1) / members;
+        for (size_t written = begin; written < end; written += 1U << 20U) {
+            const auto size = (unsigned) std::min<size_t>(1U << 20U, end - written);
+            CHECK(gzwrite(file, data.data() + written, size) == (int) size);
+        }
+        CHECK(gzclose(file) == Z_OK);
+    }
+}
+
+// a row as FastCSV returns it: getRaw() and row[i], with the quotes of the columns
+struct ReferenceRow {
+    size_t offset = 0; // of the first byte of the row in the data
+    std::string raw;
+    std::vector<std::string> columns;
+};
+
+// RFC 4180 rows, one character at a time: delimiters and newlines between quotes are part of the column, "" is an escaped quote
+// a '\r' before a newline is removed with crlf, an escape other than quote makes the character after it part of the column
+inline std::vector<ReferenceRow> referenceParse(std::string_view data, char delimiter = ',', char quote = '"', bool crlf = false, char escape = '"') {
+    std::vector<ReferenceRow> rows;
+    size_t row_begin = 0, column_begin = 0;
+    bool in_quotes = false;
+    ReferenceRow row;
+
+    for (size_t i = 0; i <= data.size(); ++i) {
+        const bool end = i == data.size();
+        if (end && row_begin == data.size()) break; // the data ends with a newline
+
+        const char c = end ? '\n' : data[i];
+        if (c == escape && escape != quote && !end) {
+            ++i;
+            continue;
+        }
+        if (c == quote) in_quotes = !in_quotes;
+        if (in_quotes && !end) continue;
+
+        if (c == delimiter) {
+            row.columns.emplace_back(data.substr(column_begin, i - column_begin));
+            column_begin = i + 1;
+        } else if (c == '\n') {
+            const size_t row_end = crlf && i > row_begin && data[i - 1] == '\r' ? i - 1 : i;
+            row.columns.emplace_back(data.substr(column_begin, row_end - column_begin));
+            row.offset = row_begin;
+            row.raw = data.substr(row_begin, row_end - row_begin);
+            rows.push_back(std::move(row));
+
+            row = ReferenceRow{};
+            row_begin = column_begin = i + 1;
+            in_quotes = false;
+        }
+    }
+    return rows;
+}
+
+// what the generated columns can contain
+struct CsvShape {
+    int columns = 5;
+    bool quoted_newlines = true; // which byte ranges and grep do not support
+    size_t long_column_every = 0; // rows, a column longer than the 16KB index window every so often
+    char escape = '\0'; // a separate escape character, escaping quotes, delimiters, newlines and itself
+};
+
+// rows starting with their number, so a row never starts with a newline, and other columns mixing plain, empty and quoted values
+inline std::string randomCsv(uint64_t seed, size_t rows, const CsvShape &shape = {}, char delimiter = ',') {
+    std::mt19937_64 random{seed};
+    std::string data;
+
+    for (size_t r = 0; r < rows; ++r) {
+        data += std::to_string(r);
+        for (int c = 1; c < shape.columns; ++c) {
+            data += delimiter;
+            if (shape.long_column_every && r % shape.long_column_every == shape.long_column_every - 1 && c == 1) {
+                data += '"' + std::string(20000 + random() % 5000, 'l') + delimiter + "\n\"";
+                continue;
+            }
+
+            switch (random() % 8) {
+                case 0:
+                    break; // empty
+                case 1:
+                    if (shape.escape) data += std::string(random() % 10, 'q') + shape.escape + delimiter + 'x' + shape.escape + '"';
+                    else data += '"' + std::string(random() % 10, 'q') + delimiter + "x\"";
+                    break;
+                case 2:
+                    // with an escape, an escaped escape before the closing quote
+                    if (shape.escape) data += std::string{"\"a "} + shape.escape + "\"quoted" + shape.escape + "\" word" + shape.escape + shape.escape + '"';
+                    else data += "\"a \"\"quoted\"\" word\"";
+                    break;
+                case 3:
+                    if (shape.quoted_newlines && shape.escape) data += std::string{"two"} + shape.escape + "\nlines";
+                    else if (shape.quoted_newlines) data += "\"two\nlines\"";
+                    else data += "one line";
+                    break;
+                case 4:
+                    data += std::to_string(random() % 1000000);
+                    break;
+                default:
+                    data += std::string(1 + random() % 30, (char) ('a' + random() % 26));
+            }
+        }
+        data += '\n';
+    }
+    return data;
+}